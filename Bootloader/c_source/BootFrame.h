@@ -13,6 +13,9 @@
  	
  	Ported to C++ by julian Schmidt 2014
 */
+#ifndef BOOTFRAME_H_
+#define BOOTFRAME_H_
+
 #include <vector>
 
 class BootFrame {
@@ -112,3 +115,5 @@ public:
 };
 
  
+
+#endif /* BOOTFRAME_H_ */
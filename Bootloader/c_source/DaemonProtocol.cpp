@@ -0,0 +1,107 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	request/response format between hex2wavd and its clients, see DaemonProtocol.h
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include "DaemonProtocol.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//-----------------------------------------------------------
+const char *daemonSocketPath()
+{
+  const char *path = getenv("HEX2WAVD_SOCKET");
+  return path ? path : HEX2WAVD_DEFAULT_SOCKET;
+}
+//-----------------------------------------------------------
+bool readAll(int fd, void *buf, size_t size)
+{
+  uint8_t *p = (uint8_t*)buf;
+  while(size > 0)
+  {
+    ssize_t n = read(fd, p, size);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+//-----------------------------------------------------------
+bool writeAll(int fd, const void *buf, size_t size)
+{
+  const uint8_t *p = (const uint8_t*)buf;
+  while(size > 0)
+  {
+    ssize_t n = write(fd, p, size);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+//-----------------------------------------------------------
+static void put32(uint8_t *p, uint32_t value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = value >> 24;
+}
+//-----------------------------------------------------------
+static uint32_t get32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+//-----------------------------------------------------------
+static bool writeMessage(int fd, const char *magic, uint32_t a, uint32_t b, uint32_t c)
+{
+  uint8_t msg[16];
+  memcpy(msg, magic, 4);
+  put32(msg+4, a);
+  put32(msg+8, b);
+  put32(msg+12, c);
+  return writeAll(fd, msg, sizeof(msg));
+}
+//-----------------------------------------------------------
+static bool readMessage(int fd, const char *magic, uint32_t &a, uint32_t &b, uint32_t &c)
+{
+  uint8_t msg[16];
+  if(!readAll(fd, msg, sizeof(msg)) || memcmp(msg, magic, 4) != 0) return false;
+  a = get32(msg+4);
+  b = get32(msg+8);
+  c = get32(msg+12);
+  return true;
+}
+//-----------------------------------------------------------
+bool writeRequest(int fd, const DaemonRequest &request)
+{
+  return writeMessage(fd, "H2WQ", request.lineCode, request.sampleRate, request.imageSize);
+}
+//-----------------------------------------------------------
+bool readRequest(int fd, DaemonRequest &request)
+{
+  return readMessage(fd, "H2WQ", request.lineCode, request.sampleRate, request.imageSize);
+}
+//-----------------------------------------------------------
+bool writeResponse(int fd, const DaemonResponse &response)
+{
+  return writeMessage(fd, "H2WR", response.status, response.sampleRate, response.samples);
+}
+//-----------------------------------------------------------
+bool readResponse(int fd, DaemonResponse &response)
+{
+  return readMessage(fd, "H2WR", response.status, response.sampleRate, response.samples);
+}
+//-----------------------------------------------------------
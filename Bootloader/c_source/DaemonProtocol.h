@@ -0,0 +1,73 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	request/response format between hex2wavd and its clients (unix domain socket)
+
+	request (client -> daemon), little endian
+	  char[4]   "H2WQ"
+	  uint32    line code (see LineCode in hex2signal.h)
+	  uint32    sample rate, HEX2WAVD_MIN_SAMPLE_RATE..HEX2WAVD_MAX_SAMPLE_RATE
+	  uint32    image size in bytes
+	  uint8[]   flash image from address 0
+
+	response (daemon -> client)
+	  char[4]   "H2WR"
+	  uint32    status, see DaemonStatus, no PCM follows unless DAEMON_OK
+	  uint32    sample rate
+	  uint32    number of samples (mono, 16 bit)
+	  int16[]   raw PCM, streamed as it is encoded
+
+	one request per connection
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#ifndef DAEMONPROTOCOL_H_
+#define DAEMONPROTOCOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HEX2WAVD_DEFAULT_SOCKET		"/tmp/hex2wavd.sock"
+#define HEX2WAVD_MAX_IMAGE		(1024*1024)
+#define HEX2WAVD_MIN_SAMPLE_RATE	8000
+#define HEX2WAVD_MAX_SAMPLE_RATE	192000
+#define HEX2WAVD_MAX_SAMPLES		(64UL*1024*1024)	// 128 MB of PCM
+
+enum DaemonStatus {
+  DAEMON_OK = 0,
+  DAEMON_BAD_REQUEST,			// bad header, line code or sample rate
+  DAEMON_IMAGE_TOO_LARGE,
+  DAEMON_OUTPUT_TOO_LARGE,		// more than HEX2WAVD_MAX_SAMPLES
+  DAEMON_OUT_OF_MEMORY
+};
+
+struct DaemonRequest {
+  uint32_t lineCode;
+  uint32_t sampleRate;
+  uint32_t imageSize;
+};
+
+struct DaemonResponse {
+  uint32_t status;
+  uint32_t sampleRate;
+  uint32_t samples;
+};
+
+// socket path from HEX2WAVD_SOCKET, HEX2WAVD_DEFAULT_SOCKET otherwise
+const char *daemonSocketPath();
+
+// full length reads/writes, false on error or end of stream
+bool readAll(int fd, void *buf, size_t size);
+bool writeAll(int fd, const void *buf, size_t size);
+
+bool writeRequest(int fd, const DaemonRequest &request);
+bool readRequest(int fd, DaemonRequest &request);
+bool writeResponse(int fd, const DaemonResponse &response);
+bool readResponse(int fd, DaemonResponse &response);
+
+#endif /* DAEMONPROTOCOL_H_ */
@@ -0,0 +1,214 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	minimal ELF32 reader: extracts the flash image straight from the linker output,
+	no objcopy/intel hex round trip needed
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include "ElfReader.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#define EI_CLASS	4
+#define EI_DATA		5
+#define ELFCLASS32	1
+#define ELFDATA2LSB	1
+
+#define ELF32_PHDR_SIZE	32
+#define ELF32_SHDR_SIZE	40
+
+#define PT_LOAD		1
+#define SHT_PROGBITS	1
+#define SHF_ALLOC	0x2
+
+//-----------------------------------------------------------
+static uint16_t read16(const std::vector<uint8_t> &file, size_t offset)
+{
+  return file[offset] | (file[offset+1] << 8);
+}
+//-----------------------------------------------------------
+static uint32_t read32(const std::vector<uint8_t> &file, size_t offset)
+{
+  return file[offset] | (file[offset+1] << 8) | (file[offset+2] << 16) | ((uint32_t)file[offset+3] << 24);
+}
+//-----------------------------------------------------------
+// the section header table has entries, lies within the file and each entry holds a full Elf32_Shdr
+static bool sectionTableValid(const std::vector<uint8_t> &file)
+{
+  const uint32_t shoff = read32(file, 32);
+  const uint16_t shentsize = read16(file, 46);
+  const uint16_t shnum = read16(file, 48);
+  const uint16_t shstrndx = read16(file, 50);
+
+  return shnum > 0 && shentsize >= ELF32_SHDR_SIZE && shstrndx < shnum &&
+         (size_t)shoff + (size_t)shnum * shentsize <= file.size();
+}
+//-----------------------------------------------------------
+// name of the allocated section starting at file offset, empty if there is none
+static std::string sectionNameAt(const std::vector<uint8_t> &file, uint32_t fileOffset)
+{
+  const uint32_t shoff = read32(file, 32);
+  const uint16_t shentsize = read16(file, 46);
+  const uint16_t shnum = read16(file, 48);
+  const uint16_t shstrndx = read16(file, 50);
+
+  if(!sectionTableValid(file)) return "";
+  const uint32_t strtab = read32(file, shoff + (size_t)shstrndx * shentsize + 16);
+
+  for(int i=0;i<shnum;i++)
+  {
+    const size_t sh = shoff + (size_t)i * shentsize;
+    if(read32(file, sh+4) != SHT_PROGBITS || !(read32(file, sh+8) & SHF_ALLOC)) continue;
+    if(read32(file, sh+16) != fileOffset) continue;
+
+    const size_t name = (size_t)strtab + read32(file, sh);
+    if(name >= file.size()) return "";
+    const char *str = (const char*)&file[name];
+    return std::string(str, strnlen(str, file.size() - name));
+  }
+  return "";
+}
+//-----------------------------------------------------------
+bool ElfReader::isElfFile(const char *filename)
+{
+  char magic[4] = {0};
+  std::ifstream in(filename, std::ios::binary);
+  in.read(magic, 4);
+  return in && memcmp(magic, "\x7f" "ELF", 4) == 0;
+}
+//-----------------------------------------------------------
+bool ElfReader::load_file(const char *filename)
+{
+  segments.clear();
+
+  std::ifstream in(filename, std::ios::binary);
+  if(!in)
+  {
+    printf("   Can't open file '%s' for reading.\n", filename);
+    return false;
+  }
+  std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  if(file.size() < 52 || memcmp(&file[0], "\x7f" "ELF", 4) != 0)
+  {
+    printf("   Error: '%s' is not an ELF file\n", filename);
+    return false;
+  }
+  if(file[EI_CLASS] != ELFCLASS32 || file[EI_DATA] != ELFDATA2LSB)
+  {
+    printf("   Error: '%s' is not a 32 bit little endian ELF file\n", filename);
+    return false;
+  }
+
+  bool ok = read16(file, 44) > 0 ? readProgramHeaders(file) : readSections(file);
+  if(!ok)
+  {
+    printf("   Error: '%s' has a broken program or section header table\n", filename);
+    return false;
+  }
+
+  size_t total = 0;
+  for(size_t i=0;i<segments.size();i++)
+  {
+    const Segment &s = segments[i];
+    printf("   %-10s %04X to %04X\n", s.name.c_str(), s.address, (unsigned int)(s.address + s.data.size() - 1));
+    total += s.data.size();
+  }
+  printf("   Loaded %d bytes from ELF file\n", (int)total);
+  return true;
+}
+//-----------------------------------------------------------
+bool ElfReader::readProgramHeaders(const std::vector<uint8_t> &file)
+{
+  const uint32_t phoff = read32(file, 28);
+  const uint16_t phentsize = read16(file, 42);
+  const uint16_t phnum = read16(file, 44);
+
+  if(phentsize < ELF32_PHDR_SIZE) return false;
+  for(int i=0;i<phnum;i++)
+  {
+    const size_t ph = phoff + (size_t)i * phentsize;
+    if(ph + 32 > file.size()) return false;
+
+    const uint32_t type = read32(file, ph);
+    const uint32_t offset = read32(file, ph+4);
+    const uint32_t paddr = read32(file, ph+12);
+    const uint32_t filesz = read32(file, ph+16);
+
+    if(type != PT_LOAD || filesz == 0 || paddr >= FLASH_END) continue;
+    if((size_t)offset + filesz > file.size()) return false;
+
+    Segment s;
+    s.name = sectionNameAt(file, offset);
+    if(s.name.empty()) s.name = "segment";
+    s.address = paddr;
+    s.data.assign(file.begin() + offset, file.begin() + offset + filesz);
+    segments.push_back(s);
+  }
+  return true;
+}
+//-----------------------------------------------------------
+bool ElfReader::readSections(const std::vector<uint8_t> &file)
+{
+  const uint32_t shoff = read32(file, 32);
+  const uint16_t shentsize = read16(file, 46);
+  const uint16_t shnum = read16(file, 48);
+  const uint16_t shstrndx = read16(file, 50);
+
+  if(shnum == 0) return true;
+  if(!sectionTableValid(file)) return false;
+
+  const uint32_t strtab = read32(file, shoff + (size_t)shstrndx * shentsize + 16);
+
+  for(int i=0;i<shnum;i++)
+  {
+    const size_t sh = shoff + (size_t)i * shentsize;
+    const uint32_t name = read32(file, sh);
+    const uint32_t type = read32(file, sh+4);
+    const uint32_t flags = read32(file, sh+8);
+    const uint32_t addr = read32(file, sh+12);
+    const uint32_t offset = read32(file, sh+16);
+    const uint32_t size = read32(file, sh+20);
+
+    if(type != SHT_PROGBITS || !(flags & SHF_ALLOC) || size == 0 || addr >= FLASH_END) continue;
+    if((size_t)offset + size > file.size()) return false;
+
+    Segment s;
+    if((size_t)strtab + name < file.size())
+    {
+      const char *str = (const char*)&file[strtab + name];
+      s.name.assign(str, strnlen(str, file.size() - strtab - name));
+    }
+    s.address = addr;
+    s.data.assign(file.begin() + offset, file.begin() + offset + size);
+    segments.push_back(s);
+  }
+  return true;
+}
+//-----------------------------------------------------------
+std::vector<uint8_t> ElfReader::getImage() const
+{
+  size_t end = 0;
+  for(size_t i=0;i<segments.size();i++)
+  {
+    if(segments[i].address + segments[i].data.size() > end) end = segments[i].address + segments[i].data.size();
+  }
+
+  std::vector<uint8_t> image(end, 0xFF);
+  for(size_t i=0;i<segments.size();i++)
+  {
+    std::copy(segments[i].data.begin(), segments[i].data.end(), image.begin() + segments[i].address);
+  }
+  return image;
+}
+//-----------------------------------------------------------
@@ -0,0 +1,53 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	minimal ELF32 reader: extracts the flash image straight from the linker output,
+	no objcopy/intel hex round trip needed
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#ifndef ELFREADER_H_
+#define ELFREADER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ElfReader {
+public:
+  // avr-gcc places RAM (.data VMA), EEPROM, fuses etc. at and above this address
+  static const uint32_t FLASH_END = 0x800000;
+
+  struct Segment {
+	  std::string name;		// section name, or "segment" when read from program headers
+	  uint32_t address;		// load (flash) address
+	  std::vector<uint8_t> data;
+  };
+
+  // true if the file starts with the ELF magic
+  static bool isElfFile(const char *filename);
+
+  /* loads all flash contents of an ELF32 little endian file
+   * PT_LOAD program headers are used if present (load address = LMA, so .data
+   * ends up behind .text as in the hex file), otherwise allocated PROGBITS sections
+   */
+  bool load_file(const char *filename);
+
+  const std::vector<Segment> &getSegments() const { return segments; }
+
+  // flash image from address 0, gaps filled with 0xFF
+  std::vector<uint8_t> getImage() const;
+
+private:
+  std::vector<Segment> segments;
+
+  bool readProgramHeaders(const std::vector<uint8_t> &file);
+  bool readSections(const std::vector<uint8_t> &file);
+};
+
+#endif /* ELFREADER_H_ */
@@ -0,0 +1,97 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	content addressed on-disk cache for generated output files and encoded pages
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include "EncoderCache.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+
+//-----------------------------------------------------------
+EncoderCache::EncoderCache(const std::string &dir)
+  : dir(dir), pageHits(0), pageMisses(0), tmpCounter(0)
+{
+  mkdir(dir.c_str(), 0777);
+  mkdir((dir + "/pages").c_str(), 0777);
+}
+//-----------------------------------------------------------
+std::string EncoderCache::entryPath(const char *subdir, uint64_t key, const char *suffix)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+  std::string path = dir + "/";
+  if(subdir) path += std::string(subdir) + "/";
+  return path + name + suffix;
+}
+//-----------------------------------------------------------
+std::string EncoderCache::tmpPath(const std::string &entry)
+{
+  return entry + ".tmp" + std::to_string(getpid()) + "." + std::to_string(tmpCounter++);
+}
+//-----------------------------------------------------------
+bool EncoderCache::copyFile(const char *src, const char *dst)
+{
+  std::ifstream in(src, std::ios::binary);
+  if(!in) return false;
+  std::ofstream out(dst, std::ios::binary);
+  if(!out) return false;
+  out << in.rdbuf();
+  out.close();
+  return !out.fail();
+}
+//-----------------------------------------------------------
+bool EncoderCache::fetchOutput(uint64_t key, const char *path)
+{
+  return copyFile(entryPath(NULL, key, ".wav").c_str(), path);
+}
+//-----------------------------------------------------------
+void EncoderCache::storeOutput(uint64_t key, const char *path)
+{
+  std::string entry = entryPath(NULL, key, ".wav");
+  std::string tmp = tmpPath(entry);
+  if(copyFile(path, tmp.c_str())) rename(tmp.c_str(), entry.c_str());
+  else unlink(tmp.c_str());
+}
+//-----------------------------------------------------------
+bool EncoderCache::loadPage(uint64_t key, std::vector<short> &samples)
+{
+  std::ifstream in(entryPath("pages", key, ".pcm").c_str(), std::ios::binary | std::ios::ate);
+  if(!in)
+  {
+    pageMisses++;
+    return false;
+  }
+  std::streamoff size = in.tellg();
+  samples.resize(size / sizeof(short));
+  in.seekg(0);
+  if(!samples.empty()) in.read((char*)&samples[0], samples.size() * sizeof(short));
+  if(!in || samples.empty())
+  {
+    pageMisses++;
+    return false;
+  }
+  pageHits++;
+  return true;
+}
+//-----------------------------------------------------------
+void EncoderCache::storePage(uint64_t key, const std::vector<short> &samples)
+{
+  std::string entry = entryPath("pages", key, ".pcm");
+  std::string tmp = tmpPath(entry);
+  std::ofstream out(tmp.c_str(), std::ios::binary);
+  out.write((const char*)&samples[0], samples.size() * sizeof(short));
+  out.close();
+  if(!out.fail()) rename(tmp.c_str(), entry.c_str());
+  else unlink(tmp.c_str());
+}
+//-----------------------------------------------------------
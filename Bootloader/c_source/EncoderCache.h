@@ -0,0 +1,91 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	content addressed on-disk cache for generated output files and encoded pages
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#ifndef ENCODERCACHE_H_
+#define ENCODERCACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// 64 bit FNV-1a, used to build the cache keys
+class CacheKey {
+public:
+  CacheKey() : hash(0xcbf29ce484222325ULL) {}
+
+  CacheKey &add(const void *data, size_t size)
+  {
+	  const uint8_t *p = (const uint8_t*)data;
+	  for(size_t i=0;i<size;i++)
+	  {
+		  hash ^= p[i];
+		  hash *= 0x100000001b3ULL;
+	  }
+	  return *this;
+  }
+  CacheKey &add(int value)
+  {
+	  return add(&value, sizeof(value));
+  }
+  CacheKey &add(uint64_t value)
+  {
+	  return add(&value, sizeof(value));
+  }
+  CacheKey &add(double value)
+  {
+	  return add(&value, sizeof(value));
+  }
+
+  uint64_t get() const { return hash; }
+
+private:
+  uint64_t hash;
+};
+
+/* Layout of the cache directory
+ *   <dir>/<key>.wav          complete output files (wav or RLPC, the format is part of the key)
+ *   <dir>/pages/<key>.pcm    encoded page frames (raw 16 bit samples)
+ * Entries are written to a temporary file and renamed, so concurrent users
+ * never see a partial entry. Page lookups are safe from several threads.
+ */
+class EncoderCache {
+public:
+  // bump whenever the generated signal changes for the same parameters
+  static const int FORMAT_VERSION = 1;
+
+  explicit EncoderCache(const std::string &dir);
+
+  // copies a cached output file to path, returns false on a cache miss
+  bool fetchOutput(uint64_t key, const char *path);
+  void storeOutput(uint64_t key, const char *path);
+
+  bool loadPage(uint64_t key, std::vector<short> &samples);
+  void storePage(uint64_t key, const std::vector<short> &samples);
+
+  unsigned int getPageHits() const { return pageHits; }
+  unsigned int getPageMisses() const { return pageMisses; }
+
+private:
+  std::string dir;
+  std::atomic<unsigned int> pageHits;
+  std::atomic<unsigned int> pageMisses;
+  std::atomic<unsigned int> tmpCounter;
+
+  std::string tmpPath(const std::string &entry);
+
+  std::string entryPath(const char *subdir, uint64_t key, const char *suffix);
+  static bool copyFile(const char *src, const char *dst);
+};
+
+#endif /* ENCODERCACHE_H_ */
@@ -0,0 +1,98 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	per stage timing and throughput of the hex to wav pipeline
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include "EncoderStats.h"
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+static const char *stageNames[EncoderStats::NUM_STAGES] = {
+  "hex_parse", "page_assembly", "encode", "sample_conversion", "file_write"
+};
+static const char *stageUnits[EncoderStats::NUM_STAGES] = {
+  "bytes", "bytes", "samples", "samples", "samples"
+};
+
+//-----------------------------------------------------------
+EncoderStats::EncoderStats()
+  : pages(0), outputFrames(0), sampleRate(0), totalSeconds(0)
+{
+  for(int i=0;i<NUM_STAGES;i++)
+  {
+    seconds[i] = 0;
+    items[i] = 0;
+  }
+}
+//-----------------------------------------------------------
+void EncoderStats::add(Stage stage, double seconds, uint64_t items)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  this->seconds[stage] += seconds;
+  this->items[stage] += items;
+}
+//-----------------------------------------------------------
+double EncoderStats::getFlashDuration() const
+{
+  if(sampleRate <= 0) return 0;
+  return (double)outputFrames / sampleRate;
+}
+//-----------------------------------------------------------
+long EncoderStats::getPeakRss()
+{
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return usage.ru_maxrss; // kB on linux
+}
+//-----------------------------------------------------------
+void EncoderStats::print(std::ostream &out) const
+{
+  char line[128];
+  out << "stage               time [ms]     throughput" << std::endl;
+  for(int i=0;i<NUM_STAGES;i++)
+  {
+    double rate = seconds[i] > 0 ? items[i] / seconds[i] : 0;
+    snprintf(line, sizeof(line), "%-18s %10.3f %14.0f %s/s", stageNames[i], seconds[i]*1000, rate, stageUnits[i]);
+    out << line << std::endl;
+  }
+  snprintf(line, sizeof(line), "%-18s %10.3f", "total", totalSeconds*1000);
+  out << line << std::endl;
+  out << "pages: " << pages << std::endl;
+  out << "peak rss: " << getPeakRss() << " kB" << std::endl;
+  snprintf(line, sizeof(line), "flash duration: %.3f s", getFlashDuration());
+  out << line << std::endl;
+}
+//-----------------------------------------------------------
+void EncoderStats::printJson(std::ostream &out) const
+{
+  char line[256];
+  out << "{" << std::endl;
+  out << "  \"stages\": {" << std::endl;
+  for(int i=0;i<NUM_STAGES;i++)
+  {
+    double rate = seconds[i] > 0 ? items[i] / seconds[i] : 0;
+    snprintf(line, sizeof(line), "    \"%s\": { \"seconds\": %.9f, \"%s\": %llu, \"%s_per_second\": %.1f }%s",
+	     stageNames[i], seconds[i], stageUnits[i], (unsigned long long)items[i], stageUnits[i], rate,
+	     i+1 < NUM_STAGES ? "," : "");
+    out << line << std::endl;
+  }
+  out << "  }," << std::endl;
+  snprintf(line, sizeof(line), "  \"total_seconds\": %.9f,", totalSeconds);
+  out << line << std::endl;
+  out << "  \"pages\": " << pages << "," << std::endl;
+  out << "  \"peak_rss_kb\": " << getPeakRss() << "," << std::endl;
+  out << "  \"samples\": " << outputFrames << "," << std::endl;
+  out << "  \"sample_rate\": " << sampleRate << "," << std::endl;
+  snprintf(line, sizeof(line), "  \"flash_duration_seconds\": %.6f", getFlashDuration());
+  out << line << std::endl;
+  out << "}" << std::endl;
+}
+//-----------------------------------------------------------
@@ -0,0 +1,119 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	per stage timing and throughput of the hex to wav pipeline
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#ifndef ENCODERSTATS_H_
+#define ENCODERSTATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+
+#include "SampleSink.h"
+
+class EncoderStats {
+public:
+  enum Stage {
+	  HEX_PARSE,		// items: bytes loaded
+	  PAGE_ASSEMBLY,	// items: frame bytes
+	  ENCODE,		// items: samples
+	  SAMPLE_CONVERSION,	// items: samples
+	  FILE_WRITE,		// items: samples
+	  NUM_STAGES
+  };
+
+  EncoderStats();
+
+  // thread safe, parallel page workers share one EncoderStats
+  void add(Stage stage, double seconds, uint64_t items);
+
+  double getSeconds(Stage stage) const { return seconds[stage]; }
+  uint64_t getItems(Stage stage) const { return items[stage]; }
+
+  // run wide values, filled in by the caller
+  void setPages(int pages) { this->pages = pages; }
+  void setOutput(size_t frames, int sampleRate) { outputFrames = frames; this->sampleRate = sampleRate; }
+  void setTotalSeconds(double seconds) { totalSeconds = seconds; }
+
+  // on-air duration of the generated signal
+  double getFlashDuration() const;
+  // peak resident set size of this process in kB
+  static long getPeakRss();
+
+  void print(std::ostream &out) const;
+  void printJson(std::ostream &out) const;
+
+private:
+  double seconds[NUM_STAGES];
+  uint64_t items[NUM_STAGES];
+  int pages;
+  size_t outputFrames;
+  int sampleRate;
+  double totalSeconds;
+  std::mutex lock;
+};
+
+// measures the time between construction and stop() (or destruction)
+class StageTimer {
+public:
+  StageTimer(EncoderStats *stats, EncoderStats::Stage stage, uint64_t items = 0)
+    : stats(stats), stage(stage), items(items), start(std::chrono::steady_clock::now())
+  {
+  }
+  ~StageTimer()
+  {
+	  stop();
+  }
+  void setItems(uint64_t items) { this->items = items; }
+  void stop()
+  {
+	  if(!stats) return;
+	  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	  stats->add(stage, elapsed.count(), items);
+	  stats = NULL;
+  }
+
+private:
+  EncoderStats *stats;
+  EncoderStats::Stage stage;
+  uint64_t items;
+  std::chrono::steady_clock::time_point start;
+};
+
+// times the write() calls of another sink as FILE_WRITE
+class TimedSink : public SampleSink {
+public:
+  TimedSink(SampleSink &sink, EncoderStats *stats) : sink(sink), stats(stats) {}
+
+  bool begin(int sampleRate, short channels, size_t totalFrames)
+  {
+	  StageTimer timer(stats, EncoderStats::FILE_WRITE);
+	  return sink.begin(sampleRate, channels, totalFrames);
+  }
+  bool write(const short *samples, size_t count)
+  {
+	  StageTimer timer(stats, EncoderStats::FILE_WRITE, count);
+	  return sink.write(samples, count);
+  }
+  bool end()
+  {
+	  StageTimer timer(stats, EncoderStats::FILE_WRITE);
+	  return sink.end();
+  }
+
+private:
+  SampleSink &sink;
+  EncoderStats *stats;
+};
+
+#endif /* ENCODERSTATS_H_ */
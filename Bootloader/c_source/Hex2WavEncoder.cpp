@@ -0,0 +1,257 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	pull based encoder: turns a flash image into the 16 bit PCM bootloader signal
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include "Hex2WavEncoder.h"
+#include "hex2signal.h"
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+//-----------------------------------------------------------
+Hex2WavEncoder::Hex2WavEncoder(const std::vector<uint8_t> &image, int sampleRate)
+  : image(image), sampleRate(sampleRate), lineCode(LINE_CODE_DIFFERENTIAL_MANCHESTER), cache(NULL), stats(NULL)
+{
+  init();
+}
+//-----------------------------------------------------------
+Hex2WavEncoder::Hex2WavEncoder(const int *data, int size, int sampleRate)
+  : sampleRate(sampleRate), lineCode(LINE_CODE_DIFFERENTIAL_MANCHESTER), cache(NULL), stats(NULL)
+{
+  if(size > 0)
+  {
+    image.resize(size);
+    for(int i=0;i<size;i++) image[i] = data[i] & 0xFF;
+  }
+  init();
+}
+//-----------------------------------------------------------
+void Hex2WavEncoder::init()
+{
+  HexToSignal h2s;
+  const int pageSize = frameSetup.getPageSize();
+
+  numPages = (image.size() + pageSize - 1) / pageSize;
+  frameSamples = h2s.getSignalLength(frameSetup.getFrameSize());
+  silenceSamples = (int)(frameSetup.getSilenceBetweenPages() * sampleRate);
+
+  // +1 leading zero sample, -1 for the dropped final sample
+  totalSamples = (size_t)numPages * (frameSamples + silenceSamples) + frameSamples;
+
+  rewind();
+}
+//-----------------------------------------------------------
+uint64_t Hex2WavEncoder::getParameterKey()
+{
+  HexToSignal h2s;
+  CacheKey key;
+  key.add(EncoderCache::FORMAT_VERSION);
+  key.add(sampleRate);
+  key.add((int)lineCode);
+  key.add(h2s.getSamplesPerBit());
+  key.add(h2s.getStartSequencePulses());
+  key.add(frameSetup.getCommand());
+  key.add(frameSetup.getPageIndex());
+  key.add(frameSetup.getCrc());
+  key.add(frameSetup.getPageStart());
+  key.add(frameSetup.getPageSize());
+  key.add(frameSetup.getFrameSize());
+  key.add(frameSetup.getSilenceBetweenPages());
+  return key.get();
+}
+//-----------------------------------------------------------
+uint64_t Hex2WavEncoder::getOutputKey()
+{
+  CacheKey key;
+  key.add(getParameterKey());
+  key.add((int)image.size());
+  if(!image.empty()) key.add(&image[0], image.size());
+  return key.get();
+}
+//-----------------------------------------------------------
+void Hex2WavEncoder::rewind()
+{
+  position = 0;
+  nextSegment = 0;
+  segment.clear();
+  segmentPosition = 0;
+}
+//-----------------------------------------------------------
+size_t Hex2WavEncoder::read(short *out, size_t maxSamples)
+{
+  size_t n = 0;
+  while(n < maxSamples && position < totalSamples)
+  {
+    if(position == 0)
+    {
+      out[n++] = 0;
+      position++;
+      continue;
+    }
+    if(segmentPosition >= segment.size())
+    {
+      encodeSegment(nextSegment++, segment);
+      segmentPosition = 0;
+    }
+
+    size_t count = segment.size() - segmentPosition;
+    if(count > maxSamples - n) count = maxSamples - n;
+    if(count > totalSamples - position) count = totalSamples - position;
+
+    memcpy(out + n, &segment[segmentPosition], count * sizeof(short));
+    n += count;
+    segmentPosition += count;
+    position += count;
+  }
+  return n;
+}
+//-----------------------------------------------------------
+bool Hex2WavEncoder::encode(SampleSink &sink, size_t blockSize)
+{
+  if(blockSize == 0) blockSize = DEFAULT_BLOCK_SIZE;
+  if(!sink.begin(sampleRate, 1, totalSamples - position)) return false;
+
+  std::vector<short> block(blockSize);
+  size_t n;
+  while((n = read(&block[0], blockSize)) > 0)
+  {
+    if(!sink.write(&block[0], n)) return false;
+  }
+  return sink.end();
+}
+//-----------------------------------------------------------
+bool Hex2WavEncoder::encodeTo(short *out, unsigned int threads)
+{
+  if(threads == 0) threads = std::thread::hardware_concurrency();
+  if(threads == 0) threads = 1;
+  if(threads > (unsigned int)numPages+1) threads = numPages+1;
+
+  out[0] = 0;
+
+  // segments are independent and their offsets are known, so workers just grab the next one
+  std::atomic<int> next(0);
+  auto worker = [&]() {
+    std::vector<short> cached;
+    int index;
+    while((index = next++) <= numPages)
+    {
+      const size_t offset = 1 + (size_t)index * (frameSamples + silenceSamples);
+      size_t limit = getSegmentLength(index);
+      if(limit > totalSamples - offset) limit = totalSamples - offset;
+
+      if(cache)
+      {
+        encodeSegment(index, cached);
+        memcpy(out + offset, &cached[0], limit * sizeof(short));
+      }
+      else
+      {
+        generateSegment(index, out + offset, limit);
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for(unsigned int i=1;i<threads;i++) workers.push_back(std::thread(worker));
+  worker();
+  for(size_t i=0;i<workers.size();i++) workers[i].join();
+  return true;
+}
+//-----------------------------------------------------------
+size_t Hex2WavEncoder::getSegmentLength(int index) const
+{
+  return index < numPages ? frameSamples + silenceSamples : frameSamples;
+}
+//-----------------------------------------------------------
+void Hex2WavEncoder::encodeSegment(int index, std::vector<short> &out)
+{
+  out.resize(getSegmentLength(index));
+  if(!cache)
+  {
+    generateSegment(index, &out[0], out.size());
+    return;
+  }
+
+  // the key covers everything that ends up in this segment
+  const int pageSize = frameSetup.getPageSize();
+  const size_t base = (size_t)index * pageSize;
+  CacheKey key;
+  key.add(getParameterKey());
+  key.add(index);
+  // only the run command depends on the page count
+  if(index == numPages) key.add(numPages);
+  if(base < image.size())
+  {
+    size_t count = image.size() - base;
+    if(count > (size_t)pageSize) count = pageSize;
+    key.add((int)count);
+    key.add(&image[base], count);
+  }
+
+  if(cache->loadPage(key.get(), out) && out.size() == getSegmentLength(index)) return;
+  out.resize(getSegmentLength(index));
+  generateSegment(index, &out[0], out.size());
+  cache->storePage(key.get(), out);
+}
+//-----------------------------------------------------------
+void Hex2WavEncoder::generateSegment(int index, short *out, size_t count)
+{
+  StageTimer assembly(stats, EncoderStats::PAGE_ASSEMBLY);
+  BootFrame frame = frameSetup;
+  const int pageStart = frame.getPageStart();
+  const int pageSize = frame.getPageSize();
+
+  std::vector<int> frameData;
+  frameData.resize(frame.getFrameSize());
+
+  if(index < numPages)
+  {
+    frame.setProgCommand();
+    frame.setPageIndex(index);
+
+    const size_t base = (size_t)index * pageSize;
+    for(int n=0;n<pageSize;n++)
+    {
+      if(base+n < image.size()) frameData[n+pageStart] = image[base+n];
+      else frameData[n+pageStart] = 0xFF;
+    }
+  }
+  else
+  {
+    // the run command carries the index of the last page written
+    frame.setRunCommand();
+    if(numPages > 0) frame.setPageIndex(numPages-1);
+  }
+  frame.addFrameParameters(frameData);
+  assembly.setItems(frameData.size());
+  assembly.stop();
+
+  StageTimer encoding(stats, EncoderStats::ENCODE);
+  HexToSignal h2s(lineCode);
+  std::vector<double> signal;
+  h2s.manchesterCoding(frameData, frame.getFrameSize(), signal);
+  encoding.setItems(signal.size());
+  encoding.stop();
+
+  StageTimer conversion(stats, EncoderStats::SAMPLE_CONVERSION);
+  const size_t frameCount = signal.size() < count ? signal.size() : count;
+  for(size_t i=0;i<frameCount;i++)
+  {
+    out[i] = signal[i]*32767;
+  }
+  for(size_t i=frameCount;i<count;i++)
+  {
+    out[i] = 0;
+  }
+  conversion.setItems(count);
+}
+//-----------------------------------------------------------
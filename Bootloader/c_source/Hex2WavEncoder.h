@@ -0,0 +1,106 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	pull based encoder: turns a flash image into the 16 bit PCM bootloader signal
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#ifndef HEX2WAVENCODER_H_
+#define HEX2WAVENCODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "BootFrame.h"
+#include "hex2signal.h"
+#include "SampleSink.h"
+#include "EncoderCache.h"
+#include "EncoderStats.h"
+
+/* The signal consists of one frame per flash page, each followed by silence,
+ * and a final run command frame. Pages are encoded on demand when read() gets
+ * to them, so only one page worth of samples is held in memory.
+ *
+ * The stream starts with a single zero sample and ends one sample before the
+ * end of the run command frame; this matches the files the original tool wrote.
+ */
+class Hex2WavEncoder {
+public:
+  static const int DEFAULT_SAMPLE_RATE = 44100;
+  static const size_t DEFAULT_BLOCK_SIZE = 1024;
+
+  // image holds the flash contents starting at address 0
+  explicit Hex2WavEncoder(const std::vector<uint8_t> &image, int sampleRate = DEFAULT_SAMPLE_RATE);
+  // data as returned by Hex2Bin::getData(), size as returned by Hex2Bin::getSize()
+  Hex2WavEncoder(const int *data, int size, int sampleRate = DEFAULT_SAMPLE_RATE);
+
+  int getSampleRate() const { return sampleRate; }
+  int getNumPages() const { return numPages; }
+  size_t getTotalSamples() const { return totalSamples; }
+  size_t getPosition() const { return position; }
+
+  // line code of all frames, call before the first read()
+  void setLineCode(LineCode lineCode) { this->lineCode = lineCode; }
+  LineCode getLineCode() const { return lineCode; }
+
+  /* encoded pages are looked up in and added to cache, NULL disables it
+   * the cache must outlive the encoder
+   */
+  void setCache(EncoderCache *cache) { this->cache = cache; }
+  // stage timings are accumulated into stats, NULL disables them
+  void setStats(EncoderStats *stats) { this->stats = stats; }
+
+  // hash over everything except the image that influences the generated signal
+  uint64_t getParameterKey();
+  // hash over the image and all parameters, identifies the complete output
+  uint64_t getOutputKey();
+
+  // restart the stream from the first sample
+  void rewind();
+
+  /* fills out with up to maxSamples samples
+   * returns the number of samples written, 0 once the stream is exhausted
+   */
+  size_t read(short *out, size_t maxSamples);
+
+  // pushes the remaining stream into sink in blocks of blockSize samples
+  bool encode(SampleSink &sink, size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+  /* writes the complete stream (getTotalSamples() samples) to out, e.g. a memory
+   * mapped file. Pages are encoded by threads workers in parallel, straight into
+   * their place in out. threads = 0 uses one per cpu. Independent of read().
+   */
+  bool encodeTo(short *out, unsigned int threads = 0);
+
+private:
+  std::vector<uint8_t> image;
+  BootFrame frameSetup;
+  int sampleRate;
+  int numPages;
+  int frameSamples;
+  int silenceSamples;
+  size_t totalSamples;
+  LineCode lineCode;
+  EncoderCache *cache;
+  EncoderStats *stats;
+
+  size_t position;
+  int nextSegment;
+  std::vector<short> segment;
+  size_t segmentPosition;
+
+  void init();
+  // segment < numPages: page frame followed by silence, segment == numPages: run command
+  size_t getSegmentLength(int index) const;
+  void encodeSegment(int index, std::vector<short> &out);
+  // writes the first count samples of the segment to out
+  void generateSegment(int index, short *out, size_t count);
+};
+
+#endif /* HEX2WAVENCODER_H_ */
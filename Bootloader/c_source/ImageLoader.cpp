@@ -0,0 +1,39 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	loads a flash image from intel hex or ELF
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include "ImageLoader.h"
+#include "ElfReader.h"
+#include "hex2bin.h"
+
+//-----------------------------------------------------------
+bool loadFlashImage(const char *path, std::vector<uint8_t> &image)
+{
+  if(ElfReader::isElfFile(path))
+  {
+    ElfReader elf;
+    if(!elf.load_file(path)) return false;
+    image = elf.getImage();
+    return true;
+  }
+
+  // Hex2Bin holds 256k, keep it off the stack
+  Hex2Bin *hex2bin = new Hex2Bin();
+  const bool ok = hex2bin->load_file((char*)path);
+  if(ok)
+  {
+    const int *data = hex2bin->getData();
+    image.assign(data, data + hex2bin->getSize());
+  }
+  delete hex2bin;
+  return ok;
+}
+//-----------------------------------------------------------
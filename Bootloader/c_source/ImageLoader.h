@@ -0,0 +1,24 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	loads a flash image from intel hex or ELF
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#ifndef IMAGELOADER_H_
+#define IMAGELOADER_H_
+
+#include <stdint.h>
+#include <vector>
+
+/* input is either intel hex or the ELF file produced by the linker,
+ * told apart by the ELF magic. Returns false if the file can't be read or parsed
+ */
+bool loadFlashImage(const char *path, std::vector<uint8_t> &image);
+
+#endif /* IMAGELOADER_H_ */
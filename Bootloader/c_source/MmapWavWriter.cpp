@@ -0,0 +1,93 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	memory mapped .wav writer
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include "MmapWavWriter.h"
+#include "wave.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define WAV_HEADER_SIZE 44
+
+//-----------------------------------------------------------
+MmapWavWriter::MmapWavWriter()
+  : fd(-1), map(NULL), mapSize(0), samples(NULL)
+{
+}
+//-----------------------------------------------------------
+MmapWavWriter::~MmapWavWriter()
+{
+  close();
+}
+//-----------------------------------------------------------
+bool MmapWavWriter::open(const char *path, int sampleRate, short channels, size_t totalFrames)
+{
+  close();
+
+  const size_t dataSize = totalFrames * channels * sizeof(short);
+  mapSize = WAV_HEADER_SIZE + dataSize;
+
+  fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if(fd < 0)
+  {
+    printf("   Can't open file '%s' for writing.\n", path);
+    return false;
+  }
+  /* reserve the blocks up front so a full disk fails here and not with SIGBUS later
+   * only a file system without fallocate support gets a sparse file instead
+   */
+  int err = posix_fallocate(fd, 0, mapSize);
+  if(err == EINVAL || err == EOPNOTSUPP) err = ftruncate(fd, mapSize) == 0 ? 0 : errno;
+  if(err != 0)
+  {
+    printf("   Can't allocate %d bytes for '%s': %s\n", (int)mapSize, path, strerror(err));
+    close();
+    unlink(path);
+    return false;
+  }
+
+  void *p = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED)
+  {
+    printf("   Can't map '%s'.\n", path);
+    close();
+    unlink(path);
+    return false;
+  }
+  map = (char*)p;
+  samples = (short*)(map + WAV_HEADER_SIZE);
+
+  writeWAVHeader<short>(map, dataSize, sampleRate, channels);
+  return true;
+}
+//-----------------------------------------------------------
+bool MmapWavWriter::close()
+{
+  bool ok = true;
+  if(map)
+  {
+    ok = munmap(map, mapSize) == 0;
+    map = NULL;
+    samples = NULL;
+  }
+  if(fd >= 0)
+  {
+    ok = (::close(fd) == 0) && ok;
+    fd = -1;
+  }
+  return ok;
+}
+//-----------------------------------------------------------
@@ -0,0 +1,42 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	memory mapped .wav writer: the file is created at its final size and mapped,
+	so the encoder writes samples straight into the page cache
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#ifndef MMAPWAVWRITER_H_
+#define MMAPWAVWRITER_H_
+
+#include <stddef.h>
+
+class MmapWavWriter {
+public:
+  MmapWavWriter();
+  ~MmapWavWriter();
+
+  /* creates path with room for totalFrames 16 bit frames, maps it and writes
+   * the RIFF header. Returns false if the file can't be created or mapped.
+   */
+  bool open(const char *path, int sampleRate, short channels, size_t totalFrames);
+
+  // first sample after the header, valid between open() and close()
+  short *getSamples() { return samples; }
+
+  // unmaps and closes the file
+  bool close();
+
+private:
+  int fd;
+  char *map;
+  size_t mapSize;
+  short *samples;
+};
+
+#endif /* MMAPWAVWRITER_H_ */
@@ -0,0 +1,124 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	multi channel encoder: one independent bootloader stream per audio channel,
+	so several modules can be flashed in parallel from one file
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include "MultiChannelEncoder.h"
+
+//-----------------------------------------------------------
+MultiChannelEncoder::MultiChannelEncoder(int sampleRate)
+  : sampleRate(sampleRate), lineCode(LINE_CODE_DIFFERENTIAL_MANCHESTER), cache(NULL), stats(NULL), totalFrames(0), position(0)
+{
+}
+//-----------------------------------------------------------
+int MultiChannelEncoder::addChannel(const std::vector<uint8_t> &image)
+{
+  channels.push_back(Hex2WavEncoder(image, sampleRate));
+  channels.back().setLineCode(lineCode);
+  channels.back().setCache(cache);
+  channels.back().setStats(stats);
+  if(channels.back().getTotalSamples() > totalFrames) totalFrames = channels.back().getTotalSamples();
+  rewind();
+  return channels.size()-1;
+}
+//-----------------------------------------------------------
+int MultiChannelEncoder::addChannel(const int *data, int size)
+{
+  channels.push_back(Hex2WavEncoder(data, size, sampleRate));
+  channels.back().setLineCode(lineCode);
+  channels.back().setCache(cache);
+  channels.back().setStats(stats);
+  if(channels.back().getTotalSamples() > totalFrames) totalFrames = channels.back().getTotalSamples();
+  rewind();
+  return channels.size()-1;
+}
+//-----------------------------------------------------------
+int MultiChannelEncoder::getNumPages() const
+{
+  int pages = 0;
+  for(size_t c=0;c<channels.size();c++) pages += channels[c].getNumPages();
+  return pages;
+}
+//-----------------------------------------------------------
+void MultiChannelEncoder::setLineCode(LineCode lineCode)
+{
+  this->lineCode = lineCode;
+  for(size_t c=0;c<channels.size();c++) channels[c].setLineCode(lineCode);
+}
+//-----------------------------------------------------------
+void MultiChannelEncoder::setCache(EncoderCache *cache)
+{
+  this->cache = cache;
+  for(size_t c=0;c<channels.size();c++) channels[c].setCache(cache);
+}
+//-----------------------------------------------------------
+void MultiChannelEncoder::setStats(EncoderStats *stats)
+{
+  this->stats = stats;
+  for(size_t c=0;c<channels.size();c++) channels[c].setStats(stats);
+}
+//-----------------------------------------------------------
+uint64_t MultiChannelEncoder::getOutputKey()
+{
+  CacheKey key;
+  key.add((int)channels.size());
+  for(size_t c=0;c<channels.size();c++) key.add(channels[c].getOutputKey());
+  return key.get();
+}
+//-----------------------------------------------------------
+void MultiChannelEncoder::rewind()
+{
+  position = 0;
+  for(size_t c=0;c<channels.size();c++) channels[c].rewind();
+}
+//-----------------------------------------------------------
+size_t MultiChannelEncoder::read(short *out, size_t maxFrames)
+{
+  const size_t numChannels = channels.size();
+  if(numChannels == 0) return 0;
+
+  size_t frames = totalFrames - position;
+  if(frames > maxFrames) frames = maxFrames;
+  if(frames == 0) return 0;
+
+  channelBuffer.resize(frames);
+  for(size_t c=0;c<numChannels;c++)
+  {
+    // an exhausted channel returns less, the rest is padding
+    size_t n = channels[c].read(&channelBuffer[0], frames);
+    for(size_t i=n;i<frames;i++) channelBuffer[i] = 0;
+
+    short *dst = out + c;
+    for(size_t i=0;i<frames;i++)
+    {
+      *dst = channelBuffer[i];
+      dst += numChannels;
+    }
+  }
+  position += frames;
+  return frames;
+}
+//-----------------------------------------------------------
+bool MultiChannelEncoder::encode(SampleSink &sink, size_t blockFrames)
+{
+  if(channels.empty()) return false;
+  if(blockFrames == 0) blockFrames = Hex2WavEncoder::DEFAULT_BLOCK_SIZE;
+  if(!sink.begin(sampleRate, getChannels(), totalFrames - position)) return false;
+
+  std::vector<short> block(blockFrames * channels.size());
+  size_t n;
+  while((n = read(&block[0], blockFrames)) > 0)
+  {
+    if(!sink.write(&block[0], n * channels.size())) return false;
+  }
+  return sink.end();
+}
+//-----------------------------------------------------------
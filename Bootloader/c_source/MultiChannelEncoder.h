@@ -0,0 +1,73 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	multi channel encoder: one independent bootloader stream per audio channel,
+	so several modules can be flashed in parallel from one file
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#ifndef MULTICHANNELENCODER_H_
+#define MULTICHANNELENCODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "Hex2WavEncoder.h"
+#include "SampleSink.h"
+
+/* All channels use the same frame layout, so page n starts on the same frame
+ * in every channel and the silence between pages lines up. Channels with fewer
+ * pages finish early and are padded with silence up to the longest one.
+ */
+class MultiChannelEncoder {
+public:
+  explicit MultiChannelEncoder(int sampleRate = Hex2WavEncoder::DEFAULT_SAMPLE_RATE);
+
+  // adds a channel, returns its index
+  int addChannel(const std::vector<uint8_t> &image);
+  int addChannel(const int *data, int size);
+
+  short getChannels() const { return channels.size(); }
+  // pages over all channels
+  int getNumPages() const;
+  int getSampleRate() const { return sampleRate; }
+  // frames = samples per channel
+  size_t getTotalFrames() const { return totalFrames; }
+  size_t getPosition() const { return position; }
+
+  // applies to all channels
+  void setLineCode(LineCode lineCode);
+
+  // shared by all channels, NULL disables it
+  void setCache(EncoderCache *cache);
+  void setStats(EncoderStats *stats);
+  // identifies the complete multichannel output
+  uint64_t getOutputKey();
+
+  void rewind();
+
+  /* fills out with up to maxFrames interleaved frames (maxFrames*getChannels() samples)
+   * returns the number of frames written, 0 once all channels are exhausted
+   */
+  size_t read(short *out, size_t maxFrames);
+
+  bool encode(SampleSink &sink, size_t blockFrames = Hex2WavEncoder::DEFAULT_BLOCK_SIZE);
+
+private:
+  int sampleRate;
+  std::vector<Hex2WavEncoder> channels;
+  LineCode lineCode;
+  EncoderCache *cache;
+  EncoderStats *stats;
+  std::vector<short> channelBuffer;
+  size_t totalFrames;
+  size_t position;
+};
+
+#endif /* MULTICHANNELENCODER_H_ */
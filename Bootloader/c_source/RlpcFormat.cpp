@@ -0,0 +1,289 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	RLPC: lossless run length container for bootloader audio, see RlpcFormat.h
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include "RlpcFormat.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <iterator>
+
+#define RLPC_VERSION	1
+#define RLPC_HEADER	16
+
+#define TOKEN_TOGGLE_MAX	0xC
+#define TOKEN_PAD		0xD
+#define TOKEN_VALUE		0xE
+#define TOKEN_REPEAT		0xF
+
+// header values expandRlpc accepts, the sample rates are the ones hex2wavd serves
+#define RLPC_MIN_SAMPLE_RATE	8000
+#define RLPC_MAX_SAMPLE_RATE	192000
+
+//-----------------------------------------------------------
+template <typename T>
+static void put(std::vector<uint8_t> &out, T value)
+{
+  for(size_t i=0;i<sizeof(T);i++) out.push_back((value >> (8*i)) & 0xFF);
+}
+//-----------------------------------------------------------
+static uint32_t get32(const std::vector<uint8_t> &in, size_t offset)
+{
+  return in[offset] | (in[offset+1] << 8) | (in[offset+2] << 16) | ((uint32_t)in[offset+3] << 24);
+}
+//-----------------------------------------------------------
+RlpcFileSink::RlpcFileSink(const char *path)
+  : path(path), sampleRate(0), channels(0), frames(0), written(0)
+{
+}
+//-----------------------------------------------------------
+bool RlpcFileSink::begin(int sampleRate, short channels, size_t totalFrames)
+{
+  this->sampleRate = sampleRate;
+  this->channels = channels;
+  frames = totalFrames;
+  written = 0;
+
+  Channel c;
+  c.value = 0;
+  c.runValue = 0;
+  c.runLength = 0;
+  state.assign(channels, c);
+  return channels > 0;
+}
+//-----------------------------------------------------------
+bool RlpcFileSink::write(const short *samples, size_t count)
+{
+  for(size_t i=0;i<count;i++)
+  {
+    Channel &c = state[(written + i) % channels];
+    if(c.runLength > 0 && samples[i] == c.runValue)
+    {
+      c.runLength++;
+      continue;
+    }
+    if(c.runLength > 0) emitRun(c, c.runValue, c.runLength);
+    c.runValue = samples[i];
+    c.runLength = 1;
+  }
+  written += count;
+  return true;
+}
+//-----------------------------------------------------------
+void RlpcFileSink::emitWord(Channel &c, uint16_t word)
+{
+  for(int shift=12;shift>=0;shift-=4) c.nibbles.push_back((word >> shift) & 0xF);
+}
+//-----------------------------------------------------------
+void RlpcFileSink::emitRun(Channel &c, short value, size_t length)
+{
+  while(length > 0)
+  {
+    size_t n;
+    if(c.value != 0 && value == -c.value)
+    {
+      n = length < TOKEN_TOGGLE_MAX+1 ? length : TOKEN_TOGGLE_MAX+1;
+      c.nibbles.push_back(n-1);
+      c.value = value;
+      length -= n;
+      continue;
+    }
+    if(value != c.value)
+    {
+      c.nibbles.push_back(TOKEN_VALUE);
+      emitWord(c, (uint16_t)value);
+      c.value = value;
+    }
+    n = length < 0x10000 ? length : 0x10000;
+    c.nibbles.push_back(TOKEN_REPEAT);
+    emitWord(c, n-1);
+    length -= n;
+  }
+}
+//-----------------------------------------------------------
+bool RlpcFileSink::end()
+{
+  const size_t totalFrames = written / channels;
+
+  std::vector<uint8_t> out;
+  out.insert(out.end(), "RLPC", "RLPC" + 4);
+  put<uint8_t>(out, RLPC_VERSION);
+  put<uint8_t>(out, 16);
+  put<uint16_t>(out, channels);
+  put<uint32_t>(out, sampleRate);
+  put<uint32_t>(out, totalFrames);
+
+  for(size_t ch=0;ch<state.size();ch++)
+  {
+    Channel &c = state[ch];
+    if(c.runLength > 0) emitRun(c, c.runValue, c.runLength);
+    c.runLength = 0;
+    if(c.nibbles.size() & 1) c.nibbles.push_back(TOKEN_PAD);
+
+    put<uint32_t>(out, c.nibbles.size()/2);
+    for(size_t i=0;i<c.nibbles.size();i+=2) out.push_back((c.nibbles[i] << 4) | c.nibbles[i+1]);
+  }
+
+  std::ofstream stream(path, std::ios::binary);
+  if(!stream)
+  {
+    printf("   Can't open file '%s' for writing.\n", path);
+    return false;
+  }
+  stream.write((const char*)&out[0], out.size());
+  stream.close();
+  return !stream.fail();
+}
+//-----------------------------------------------------------
+// decoder state of one channel
+struct RlpcDecoder {
+  const uint8_t *data;
+  size_t nibbles;
+  size_t pos;
+  short value;
+  size_t pending;
+
+  int next()
+  {
+    if(pos >= nibbles) return -1;
+    uint8_t b = data[pos/2];
+    int n = (pos & 1) ? (b & 0xF) : (b >> 4);
+    pos++;
+    return n;
+  }
+  int word()
+  {
+    int w = 0;
+    for(int i=0;i<4;i++)
+    {
+      int n = next();
+      if(n < 0) return -1;
+      w = (w << 4) | n;
+    }
+    return w;
+  }
+  // next sample, false on a broken stream
+  bool sample(short &out)
+  {
+    while(pending == 0)
+    {
+      int token = next();
+      if(token < 0 || token == TOKEN_PAD) return false;
+      if(token <= TOKEN_TOGGLE_MAX)
+      {
+        value = -value;
+        pending = token + 1;
+      }
+      else
+      {
+        int w = word();
+        if(w < 0) return false;
+        if(token == TOKEN_VALUE) value = (short)w;
+        else pending = w + 1;
+      }
+    }
+    pending--;
+    out = value;
+    return true;
+  }
+};
+//-----------------------------------------------------------
+// most samples a run stream of that many nibbles can decode to, a repeat token gives 65536 per 5 nibbles
+static size_t maxSamples(size_t nibbles)
+{
+  return nibbles / 5 * 65536 + nibbles % 5 * (TOKEN_TOGGLE_MAX+1);
+}
+//-----------------------------------------------------------
+bool isRlpcFile(const char *path)
+{
+  char magic[4] = {0};
+  std::ifstream in(path, std::ios::binary);
+  in.read(magic, 4);
+  return in && memcmp(magic, "RLPC", 4) == 0;
+}
+//-----------------------------------------------------------
+bool expandRlpc(const char *path, SampleSink &sink)
+{
+  std::ifstream in(path, std::ios::binary);
+  if(!in)
+  {
+    printf("   Can't open file '%s' for reading.\n", path);
+    return false;
+  }
+  std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  if(file.size() < RLPC_HEADER || memcmp(&file[0], "RLPC", 4) != 0 || file[4] != RLPC_VERSION || file[5] != 16)
+  {
+    printf("   Error: '%s' is not a RLPC file\n", path);
+    return false;
+  }
+  const int channelCount = file[6] | (file[7] << 8);
+  const uint32_t sampleRate = get32(file, 8);
+  const size_t frames = get32(file, 12);
+
+  // every channel needs at least its length field, check before anything is allocated
+  if(channelCount <= 0 || channelCount > 0x7FFF || (size_t)channelCount * 4 > file.size() - RLPC_HEADER ||
+     sampleRate < RLPC_MIN_SAMPLE_RATE || sampleRate > RLPC_MAX_SAMPLE_RATE)
+  {
+    printf("   Error: '%s' has a broken RLPC header\n", path);
+    return false;
+  }
+  const short channels = channelCount;
+
+  std::vector<RlpcDecoder> decoders(channels);
+  size_t offset = RLPC_HEADER;
+  for(short ch=0;ch<channels;ch++)
+  {
+    if(offset + 4 > file.size()) return false;
+    const size_t length = get32(file, offset);
+    offset += 4;
+    if(offset + length > file.size()) return false;
+    if(frames > maxSamples(length * 2))
+    {
+      printf("   Error: '%s' run stream of channel %d is shorter than %zu frames\n", path, ch, frames);
+      return false;
+    }
+
+    RlpcDecoder &d = decoders[ch];
+    d.data = &file[0] + offset;
+    d.nibbles = length * 2;
+    d.pos = 0;
+    d.value = 0;
+    d.pending = 0;
+    offset += length;
+  }
+
+  if(!sink.begin(sampleRate, channels, frames)) return false;
+
+  const size_t blockFrames = 1024;
+  std::vector<short> block(blockFrames * channels);
+  for(size_t frame=0;frame<frames;)
+  {
+    size_t n = frames - frame < blockFrames ? frames - frame : blockFrames;
+    short *out = &block[0];
+    for(size_t i=0;i<n;i++)
+    {
+      for(short ch=0;ch<channels;ch++)
+      {
+        if(!decoders[ch].sample(*out++))
+        {
+          printf("   Error: '%s' run stream of channel %d is broken\n", path, ch);
+          return false;
+        }
+      }
+    }
+    if(!sink.write(&block[0], n * channels)) return false;
+    frame += n;
+  }
+  return sink.end();
+}
+//-----------------------------------------------------------
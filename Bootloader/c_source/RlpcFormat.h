@@ -0,0 +1,81 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	RLPC: lossless run length container for bootloader audio
+
+	The generated signal consists of runs of +-full scale and silence, so it is
+	stored as runs instead of samples. Expanding an RLPC file gives back exactly
+	the 16 bit PCM the encoder produced.
+
+	File layout (little endian)
+	  char[4]   "RLPC"
+	  uint8     version (1)
+	  uint8     bits per sample (16)
+	  uint16    channels
+	  uint32    sample rate
+	  uint32    frames (samples per channel)
+	  then for every channel
+	    uint32  length of the run stream in bytes
+	    uint8[] run stream
+
+	Run stream: 4 bit tokens, high nibble first. The decoder keeps the current
+	sample value v, starting at 0.
+	  0x0-0xC   v = -v, then output v (token+1) times (1..13 samples)
+	  0xD       padding / reserved
+	  0xE       the next 4 tokens are the new value of v (int16, most significant first)
+	  0xF       the next 4 tokens are n, output v (n+1) times
+	Decoding stops after 'frames' samples.
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#ifndef RLPCFORMAT_H_
+#define RLPCFORMAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "SampleSink.h"
+
+// collects the stream as runs and writes the RLPC file on end()
+class RlpcFileSink : public SampleSink {
+public:
+  explicit RlpcFileSink(const char *path);
+
+  bool begin(int sampleRate, short channels, size_t totalFrames);
+  bool write(const short *samples, size_t count);
+  bool end();
+
+private:
+  struct Channel {
+	  short value;		// decoder state
+	  short runValue;
+	  size_t runLength;
+	  std::vector<uint8_t> nibbles;
+  };
+
+  const char *path;
+  int sampleRate;
+  short channels;
+  size_t frames;
+  size_t written;
+  std::vector<Channel> state;
+
+  void emitRun(Channel &c, short value, size_t length);
+  static void emitWord(Channel &c, uint16_t word);
+};
+
+/* tiny expander: decodes an RLPC file into sink
+ * returns false if the file can't be read or is broken
+ */
+bool expandRlpc(const char *path, SampleSink &sink);
+
+// true if the file starts with the RLPC magic
+bool isRlpcFile(const char *path);
+
+#endif /* RLPCFORMAT_H_ */
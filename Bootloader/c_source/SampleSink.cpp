@@ -0,0 +1,86 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	sample sinks: destinations for the 16 bit PCM stream produced by Hex2WavEncoder
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include "SampleSink.h"
+#include "wave.h"
+
+//-----------------------------------------------------------
+WavFileSink::WavFileSink(const char *path)
+  : path(path), sampleRate(0), channels(0), announcedBytes(0), writtenBytes(0)
+{
+}
+//-----------------------------------------------------------
+bool WavFileSink::begin(int sampleRate, short channels, size_t totalFrames)
+{
+  this->sampleRate = sampleRate;
+  this->channels = channels;
+  announcedBytes = totalFrames * channels * sizeof(short);
+  writtenBytes = 0;
+
+  stream.open(path, std::ios::binary);
+  if(!stream)
+  {
+    printf("   Can't open file '%s' for writing.\n", path);
+    return false;
+  }
+  writeWAVHeader<short>(stream, announcedBytes, sampleRate, channels);
+  return stream.good();
+}
+//-----------------------------------------------------------
+bool WavFileSink::write(const short *samples, size_t count)
+{
+  stream.write((const char*)samples, count * sizeof(short));
+  writtenBytes += count * sizeof(short);
+  return stream.good();
+}
+//-----------------------------------------------------------
+bool WavFileSink::end()
+{
+  if(writtenBytes != announcedBytes)
+  {
+    stream.seekp(0);
+    writeWAVHeader<short>(stream, writtenBytes, sampleRate, channels);
+  }
+  stream.close();
+  return !stream.fail();
+}
+//-----------------------------------------------------------
+bool MemorySink::begin(int sampleRate, short channels, size_t totalFrames)
+{
+  this->sampleRate = sampleRate;
+  this->channels = channels;
+  samples.clear();
+  samples.reserve(totalFrames * channels);
+  return true;
+}
+//-----------------------------------------------------------
+bool MemorySink::write(const short *samples, size_t count)
+{
+  this->samples.insert(this->samples.end(), samples, samples + count);
+  return true;
+}
+//-----------------------------------------------------------
+bool RawPcmSink::write(const short *samples, size_t count)
+{
+  return fwrite(samples, sizeof(short), count, out) == count;
+}
+//-----------------------------------------------------------
+bool RawPcmSink::end()
+{
+  return fflush(out) == 0;
+}
+//-----------------------------------------------------------
+bool CallbackSink::write(const short *samples, size_t count)
+{
+  return callback(samples, count);
+}
+//-----------------------------------------------------------
@@ -0,0 +1,104 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	sample sinks: destinations for the 16 bit PCM stream produced by Hex2WavEncoder
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#ifndef SAMPLESINK_H_
+#define SAMPLESINK_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+/* A sink receives interleaved 16 bit samples.
+ * begin() is called once with the stream format and the total number of frames
+ * (one frame = one sample per channel), followed by any number of write() calls
+ * and a final end(). All calls return false on error.
+ */
+class SampleSink {
+public:
+  virtual ~SampleSink() {}
+
+  virtual bool begin(int sampleRate, short channels, size_t totalFrames)
+  {
+	  (void)sampleRate; (void)channels; (void)totalFrames;
+	  return true;
+  }
+  virtual bool write(const short *samples, size_t count) = 0;
+  virtual bool end()
+  {
+	  return true;
+  }
+};
+
+// .wav file, RIFF header is fixed up on end() if fewer samples were written than announced
+class WavFileSink : public SampleSink {
+public:
+  explicit WavFileSink(const char *path);
+
+  bool begin(int sampleRate, short channels, size_t totalFrames);
+  bool write(const short *samples, size_t count);
+  bool end();
+
+private:
+  const char *path;
+  std::ofstream stream;
+  int sampleRate;
+  short channels;
+  size_t announcedBytes;
+  size_t writtenBytes;
+};
+
+// collects all samples in memory
+class MemorySink : public SampleSink {
+public:
+  MemorySink() : sampleRate(0), channels(0) {}
+
+  bool begin(int sampleRate, short channels, size_t totalFrames);
+  bool write(const short *samples, size_t count);
+
+  const std::vector<short> &getSamples() const { return samples; }
+  int getSampleRate() const { return sampleRate; }
+  short getChannels() const { return channels; }
+
+private:
+  std::vector<short> samples;
+  int sampleRate;
+  short channels;
+};
+
+// headerless raw PCM (native endian) to a stdio stream, stdout by default
+class RawPcmSink : public SampleSink {
+public:
+  explicit RawPcmSink(FILE *out = stdout) : out(out) {}
+
+  bool write(const short *samples, size_t count);
+  bool end();
+
+private:
+  FILE *out;
+};
+
+// forwards every block to a user supplied function, e.g. a sound card buffer
+class CallbackSink : public SampleSink {
+public:
+  typedef std::function<bool(const short *samples, size_t count)> Callback;
+
+  explicit CallbackSink(Callback callback) : callback(callback) {}
+
+  bool write(const short *samples, size_t count);
+
+private:
+  Callback callback;
+};
+
+#endif /* SAMPLESINK_H_ */
@@ -12,24 +12,40 @@
  	 	
 */
 
+#ifndef WAVECODEGENERATOR_H_
+#define WAVECODEGENERATOR_H_
+
 #include "hex2bin.h"
 #include "hex2signal.h"
 #include "BootFrame.h"
 #include "wave.h"
+#include "Hex2WavEncoder.h"
+#include "MultiChannelEncoder.h"
+#include "ElfReader.h"
+#include "RlpcFormat.h"
+#include "ImageLoader.h"
+#include "MmapWavWriter.h"
 
 #include <vector>
+#include <string>
+#include <fstream>
 
 #include <stdlib.h>   
 using namespace std;
 
-static int sampleRate = 44100;		// Samples per second
+static const int sampleRate = Hex2WavEncoder::DEFAULT_SAMPLE_RATE;		// Samples per second
 
 
  
 class WavCodeGenerator {
   
 public:
-  WavCodeGenerator()
+  enum OutputFormat {
+	  FORMAT_WAV,
+	  FORMAT_RLPC	// run length container, see RlpcFormat.h
+  };
+
+  WavCodeGenerator() : lineCode(LINE_CODE_DIFFERENTIAL_MANCHESTER), outputFormat(FORMAT_WAV), threads(0), printStats(false)
   {
 
   };
@@ -123,31 +139,169 @@ public:
 	  cout << "###################################" << endl;
 
 
-	  Hex2Bin hex2bin;
-	  hex2bin.load_file(hexFilePath);
+	  EncoderStats stats;
+	  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	  std::vector<uint8_t> image;
+	  StageTimer parse(&stats, EncoderStats::HEX_PARSE);
+	  if(!loadFlashImage(hexFilePath, image)) return false;
+	  parse.setItems(image.size());
+	  parse.stop();
+
+	  Hex2WavEncoder encoder(image, sampleRate);
+	  encoder.setLineCode(lineCode);
+	  cout << "generating " << encoder.getNumPages() << " pages" << endl;
+
+	  cout << "saving wave file of size " << encoder.getTotalSamples() << endl;
+	  bool ok = encodeToFile(encoder, wavFilePath, stats);
+
+	  stats.setPages(encoder.getNumPages());
+	  stats.setOutput(encoder.getTotalSamples(), sampleRate);
+	  reportStats(stats, start);
+	  return ok;
+  }
 
-	  int *srcData = hex2bin.getData();
+  // one hex file per channel, all modules are flashed in parallel
+  bool convertHexes2Wav(std::vector<char*> &hexFilePaths, char* wavFilePath)
+  {
+	  cout << "######## Intel HEX to .wav ########" << endl;
+	  cout << "#    AVR audio bootloader tool    #" << endl;
+	  cout << "###################################" << endl;
 
-	  cout << "generating";
-	  std::vector<double> signal;
-	  generateSignal(srcData, hex2bin.getSize(),signal);
-	  cout << endl;
+	  EncoderStats stats;
+	  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-	  cout << "saving wave file of size " << signal.size() << endl;
-	  short data[signal.size()+1];
-	  data[0]=0;
-	  for(unsigned int i=0;i<signal.size();i++)
+	  MultiChannelEncoder encoder(sampleRate);
+	  encoder.setLineCode(lineCode);
+	  for(size_t i=0;i<hexFilePaths.size();i++)
 	  {
-	    data[i+1] = signal[i]*32767;
+		  std::vector<uint8_t> image;
+		  StageTimer parse(&stats, EncoderStats::HEX_PARSE);
+		  if(!loadFlashImage(hexFilePaths[i], image)) return false;
+		  parse.setItems(image.size());
+		  parse.stop();
+		  encoder.addChannel(image);
 	  }
 
-	  writeWAVData(wavFilePath, data, signal.size()*2,sampleRate,1);
+	  cout << "saving " << encoder.getChannels() << " channel wave file of size " << encoder.getTotalFrames() << endl;
+	  bool ok = encodeToFile(encoder, wavFilePath, stats);
+
+	  stats.setPages(encoder.getNumPages());
+	  stats.setOutput(encoder.getTotalFrames(), sampleRate);
+	  reportStats(stats, start);
+	  return ok;
+  }
+
+  // line code used by convertHex2Wav/convertHexes2Wav
+  void setLineCode(LineCode lineCode)
+  {
+	  this->lineCode = lineCode;
+  }
+
+  // page workers for .wav output, 0 = one per cpu
+  void setThreads(unsigned int threads)
+  {
+	  this->threads = threads;
+  }
+
+  void setOutputFormat(OutputFormat outputFormat)
+  {
+	  this->outputFormat = outputFormat;
+  }
 
-	  return true;
+  // expands a RLPC file back to the original .wav
+  bool expandRlpc2Wav(char* rlpcFilePath, char* wavFilePath)
+  {
+	  WavFileSink sink(wavFilePath);
+	  return expandRlpc(rlpcFilePath, sink);
+  }
+
+  // keep generated files and encoded pages in cacheDir, empty disables the cache
+  void setCacheDir(const std::string &cacheDir)
+  {
+	  this->cacheDir = cacheDir;
+  }
+
+  // print per stage timings after each conversion, and write them as JSON to jsonPath if not empty
+  void setStats(bool printStats, const std::string &jsonPath)
+  {
+	  this->printStats = printStats;
+	  statsJsonPath = jsonPath;
   }
   
 private:
   BootFrame frameSetup;
+  LineCode lineCode;
+  OutputFormat outputFormat;
+  unsigned int threads;
+  std::string cacheDir;
+  bool printStats;
+  std::string statsJsonPath;
+
+  void reportStats(EncoderStats &stats, std::chrono::steady_clock::time_point start)
+  {
+	  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	  stats.setTotalSeconds(elapsed.count());
+	  if(printStats) stats.print(cout);
+	  if(!statsJsonPath.empty())
+	  {
+		  std::ofstream json(statsJsonPath.c_str());
+		  stats.printJson(json);
+	  }
+  }
+
+  template <typename Encoder>
+  bool writeOutput(Encoder &encoder, char* wavFilePath, SampleSink &sink, EncoderStats &stats)
+  {
+	  (void)wavFilePath; (void)stats;
+	  return encoder.encode(sink);
+  }
+
+  // mono .wav: pages are encoded in parallel straight into the memory mapped file
+  bool writeOutput(Hex2WavEncoder &encoder, char* wavFilePath, SampleSink &sink, EncoderStats &stats)
+  {
+	  if(outputFormat != FORMAT_WAV) return encoder.encode(sink);
+
+	  MmapWavWriter writer;
+	  StageTimer create(&stats, EncoderStats::FILE_WRITE);
+	  if(!writer.open(wavFilePath, sampleRate, 1, encoder.getTotalSamples())) return false;
+	  create.stop();
+
+	  bool ok = encoder.encodeTo(writer.getSamples(), threads);
+
+	  StageTimer unmap(&stats, EncoderStats::FILE_WRITE, encoder.getTotalSamples());
+	  return writer.close() && ok;
+  }
+
+  template <typename Encoder>
+  bool encodeToFile(Encoder &encoder, char* wavFilePath, EncoderStats &stats)
+  {
+	  encoder.setStats(&stats);
+	  WavFileSink wavFile(wavFilePath);
+	  RlpcFileSink rlpcFile(wavFilePath);
+	  SampleSink &file = outputFormat == FORMAT_RLPC ? (SampleSink&)rlpcFile : (SampleSink&)wavFile;
+	  TimedSink sink(file, &stats);
+
+	  if(cacheDir.empty())
+	  {
+		  return writeOutput(encoder, wavFilePath, sink, stats);
+	  }
+
+	  EncoderCache cache(cacheDir);
+	  const uint64_t key = CacheKey().add(encoder.getOutputKey()).add((int)outputFormat).get();
+	  if(cache.fetchOutput(key, wavFilePath))
+	  {
+		  cout << "cache hit" << endl;
+		  return true;
+	  }
+
+	  encoder.setCache(&cache);
+	  bool ok = writeOutput(encoder, wavFilePath, sink, stats);
+	  encoder.setCache(NULL);
+	  cout << "page cache: " << cache.getPageHits() << " hits, " << cache.getPageMisses() << " misses" << endl;
+	  if(ok) cache.storeOutput(key, wavFilePath);
+	  return ok;
+  }
   
   void appendSignal(std::vector<double> &sig1, std::vector<double> &sig2)
   {
@@ -159,3 +313,5 @@ private:
 	  }
   }
 };
+
+#endif /* WAVECODEGENERATOR_H_ */
@@ -0,0 +1,365 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	microbenchmarks for the hex to wav pipeline
+
+	usage: bench [--baseline FILE] [--write-baseline FILE] [--tolerance PERCENT] [--rounds N]
+
+	Every benchmark runs on synthetic images of 16 kB, 64 kB and 1 MB generated
+	from a fixed seed and reports the best CPU time of several runs, taken over
+	N rounds of the whole suite. Each round also times a fixed reference loop,
+	results are compared relative to it, so a slower machine or a loaded phase
+	of a shared one cancels out (load_file only up to
+	64 kB, Hex2Bin has no extended address records). With --baseline the results
+	are compared against a stored run. Only the CPU bound in-memory benchmarks are
+	gated: the program exits with 1 if one of them is slower than the baseline by
+	more than the tolerance. Benchmarks that touch files (load_file, writeWAVData)
+	are informational, their deltas are printed but never fail the run. A gated
+	benchmark faster than the band is flagged, its baseline is stale.
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "../WaveCodeGenerator.h"
+
+struct Result {
+  string name;
+  double nsPerByte;
+  double samplesPerSecond;
+  double relative;		// nsPerByte / reference loop ns per byte of the same round
+  bool gated;			// CPU bound, compared against the baseline
+};
+
+struct BaselineEntry {
+  double nsPerByte;
+  double relative;
+};
+
+//-----------------------------------------------------------
+// xorshift32, fixed seed so every run sees the same images
+static vector<uint8_t> makeImage(size_t size)
+{
+  vector<uint8_t> image(size);
+  uint32_t x = 0x2545F491;
+  for(size_t i=0;i<size;i++)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    image[i] = x & 0xFF;
+  }
+  return image;
+}
+//-----------------------------------------------------------
+// intel hex with 32 byte records, image at most 64 kB
+static void writeHexFile(const char *path, const vector<uint8_t> &image)
+{
+  FILE *f = fopen(path, "w");
+  for(size_t addr=0;addr<image.size();addr+=32)
+  {
+    size_t len = image.size() - addr < 32 ? image.size() - addr : 32;
+    int sum = len + ((addr >> 8) & 0xFF) + (addr & 0xFF);
+    fprintf(f, ":%02X%04X00", (int)len, (int)(addr & 0xFFFF));
+    for(size_t i=0;i<len;i++)
+    {
+      fprintf(f, "%02X", image[addr+i]);
+      sum += image[addr+i];
+    }
+    fprintf(f, "%02X\n", (-sum) & 0xFF);
+  }
+  fprintf(f, ":00000001FF\n");
+  fclose(f);
+}
+//-----------------------------------------------------------
+// CPU time of the process, time other processes take from a loaded machine is not counted
+static double cpuSeconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+//-----------------------------------------------------------
+template <typename F>
+static double bestOf(int runs, F f)
+{
+  double best = 1e30;
+  for(int i=0;i<runs;i++)
+  {
+    const double start = cpuSeconds();
+    f();
+    const double elapsed = cpuSeconds() - start;
+    if(elapsed < best) best = elapsed;
+  }
+  return best;
+}
+//-----------------------------------------------------------
+// reference loop: xorshift fill and copy of 256 kB, ns per byte
+static double calibrate(int runs)
+{
+  vector<uint8_t> a(256*1024), b(a.size());
+  double t = bestOf(runs, [&]() {
+    uint32_t x = 0x2545F491;
+    for(size_t i=0;i<a.size();i++)
+    {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      a[i] = x & 0xFF;
+    }
+    memcpy(&b[0], &a[0], a.size());
+    // keeps the loop from being optimized away
+    *(volatile uint8_t*)&b[x % b.size()];
+  });
+  return t * 1e9 / a.size();
+}
+//-----------------------------------------------------------
+static void addResult(vector<Result> &results, const string &name, size_t bytes, size_t samples, double seconds,
+                      bool gated = true)
+{
+  Result r;
+  r.name = name;
+  r.gated = gated;
+  r.nsPerByte = seconds * 1e9 / bytes;
+  r.samplesPerSecond = samples ? samples / seconds : 0;
+  results.push_back(r);
+}
+//-----------------------------------------------------------
+static void runBenchmarks(size_t size, int runs, vector<Result> &results)
+{
+  char sizeName[16];
+  if(size >= 1024*1024) snprintf(sizeName, sizeof(sizeName), "%dM", (int)(size >> 20));
+  else snprintf(sizeName, sizeof(sizeName), "%dK", (int)(size >> 10));
+  const string suffix = string("/") + sizeName;
+
+  const vector<uint8_t> image = makeImage(size);
+  vector<int> data(image.begin(), image.end());
+
+  // progress output of the tools goes nowhere
+  streambuf *coutBuf = cout.rdbuf(NULL);
+  FILE *devNull = fopen("/dev/null", "w");
+  int stdoutFd = dup(1);
+  fflush(stdout);
+  dup2(fileno(devNull), 1);
+
+  // Hex2Bin::load_file, reads a file and only holds 64 kB
+  double t;
+  int fd;
+  if(size <= 65536)
+  {
+    char hexPath[] = "/tmp/hex2wav_bench_XXXXXX";
+    fd = mkstemp(hexPath);
+    close(fd);
+    writeHexFile(hexPath, image);
+    Hex2Bin *hex2bin = new Hex2Bin();
+    t = bestOf(runs, [&]() { hex2bin->load_file(hexPath); });
+    addResult(results, "load_file" + suffix, size, 0, t, false);
+    delete hex2bin;
+    unlink(hexPath);
+  }
+
+  // HexToSignal::manchesterCoding, one frame per page as the encoder uses it
+  BootFrame frame;
+  const int pageSize = frame.getPageSize();
+  size_t samples = 0;
+  t = bestOf(runs, [&]() {
+    std::vector<int> frameData(frame.getFrameSize());
+    std::vector<double> signal;
+    samples = 0;
+    for(size_t base=0;base<size;base+=pageSize)
+    {
+      for(int n=0;n<pageSize;n++) frameData[n+frame.getPageStart()] = base+n < size ? image[base+n] : 0xFF;
+      HexToSignal h2s;
+      h2s.manchesterCoding(frameData, frame.getFrameSize(), signal);
+      samples += signal.size();
+    }
+  });
+  addResult(results, "manchesterCoding" + suffix, size, samples, t);
+
+  // WavCodeGenerator::generateSignal
+  std::vector<double> signal;
+  t = bestOf(runs, [&]() {
+    WavCodeGenerator generator;
+    signal.clear();
+    signal.shrink_to_fit();
+    generator.generateSignal(&data[0], size, signal);
+  });
+  addResult(results, "generateSignal" + suffix, size, signal.size(), t);
+
+  // writeWAVData
+  std::vector<short> pcm(signal.size());
+  for(size_t i=0;i<signal.size();i++) pcm[i] = signal[i]*32767;
+  signal.clear();
+  signal.shrink_to_fit();
+  char wavPath[] = "/tmp/hex2wav_bench_XXXXXX";
+  fd = mkstemp(wavPath);
+  close(fd);
+  t = bestOf(runs, [&]() { writeWAVData(wavPath, &pcm[0], pcm.size()*2, sampleRate, 1); });
+  addResult(results, "writeWAVData" + suffix, size, pcm.size(), t, false);
+  unlink(wavPath);
+
+  // Hex2WavEncoder::read, the streaming pipeline
+  t = bestOf(runs, [&]() {
+    Hex2WavEncoder encoder(image);
+    short block[Hex2WavEncoder::DEFAULT_BLOCK_SIZE];
+    samples = 0;
+    size_t n;
+    while((n = encoder.read(block, Hex2WavEncoder::DEFAULT_BLOCK_SIZE)) > 0) samples += n;
+  });
+  addResult(results, "encoder_read" + suffix, size, samples, t);
+
+  fflush(stdout);
+  dup2(stdoutFd, 1);
+  close(stdoutFd);
+  fclose(devNull);
+  cout.rdbuf(coutBuf);
+}
+//-----------------------------------------------------------
+static map<string, BaselineEntry> loadBaseline(const char *path)
+{
+  map<string, BaselineEntry> baseline;
+  ifstream in(path);
+  string line;
+  while(getline(in, line))
+  {
+    if(line.empty() || line[0] == '#') continue;
+    istringstream fields(line);
+    string name;
+    BaselineEntry entry;
+    if(fields >> name >> entry.nsPerByte >> entry.relative) baseline[name] = entry;
+  }
+  return baseline;
+}
+//-----------------------------------------------------------
+// best of each benchmark relative to the reference loop, merged into results
+static void runRounds(int rounds, vector<Result> &results, double &reference)
+{
+  for(int round=0;round<rounds;round++)
+  {
+    vector<Result> roundResults;
+    const double cal = calibrate(16);
+    runBenchmarks(16*1024, 8, roundResults);
+    runBenchmarks(64*1024, 4, roundResults);
+    runBenchmarks(1024*1024, 2, roundResults);
+    for(size_t i=0;i<roundResults.size();i++) roundResults[i].relative = roundResults[i].nsPerByte / cal;
+
+    if(results.empty()) results = roundResults;
+    if(reference == 0 || cal < reference) reference = cal;
+    for(size_t i=0;i<results.size();i++)
+    {
+      if(roundResults[i].relative >= results[i].relative) continue;
+      results[i] = roundResults[i];
+    }
+  }
+}
+//-----------------------------------------------------------
+// change against the baseline in percent, relative to the reference loop
+static double deltaOf(const Result &r, const BaselineEntry &b)
+{
+  return (r.relative / b.relative - 1) * 100;
+}
+//-----------------------------------------------------------
+static bool hasRegression(const vector<Result> &results, const map<string, BaselineEntry> &baseline, double tolerance)
+{
+  for(size_t i=0;i<results.size();i++)
+  {
+    map<string, BaselineEntry>::const_iterator b = baseline.find(results[i].name);
+    if(results[i].gated && b != baseline.end() && deltaOf(results[i], b->second) > tolerance) return true;
+  }
+  return false;
+}
+//-----------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  const char *baselinePath = NULL;
+  const char *writePath = NULL;
+  double tolerance = 30;
+  int rounds = 5;
+
+  for(int i=1;i<argc;i++)
+  {
+    if(strcmp(argv[i], "--baseline") == 0 && i+1 < argc) baselinePath = argv[++i];
+    else if(strcmp(argv[i], "--write-baseline") == 0 && i+1 < argc) writePath = argv[++i];
+    else if(strcmp(argv[i], "--tolerance") == 0 && i+1 < argc) tolerance = atof(argv[++i]);
+    else if(strcmp(argv[i], "--rounds") == 0 && i+1 < argc) rounds = atoi(argv[++i]);
+    else
+    {
+      cout << "usage: bench [--baseline FILE] [--write-baseline FILE] [--tolerance PERCENT] [--rounds N]" << endl;
+      return 1;
+    }
+  }
+
+  /* freed buffers stay in the process, otherwise every run maps and faults in its
+   * signal vectors again and the kernel time of that dominates the noise
+   */
+  mallopt(M_MMAP_THRESHOLD, 1024*1024*1024);
+  mallopt(M_TRIM_THRESHOLD, -1);
+
+  map<string, BaselineEntry> baseline;
+  if(baselinePath) baseline = loadBaseline(baselinePath);
+
+  vector<Result> results;
+  double reference = 0;
+  runRounds(rounds < 1 ? 1 : rounds, results, reference);
+  // a regression has to survive more rounds before it fails the run, noise does not
+  for(int retry=0;retry<2 && hasRegression(results, baseline, tolerance);retry++)
+  {
+    printf("over the tolerance, running %d more rounds\n", rounds);
+    runRounds(rounds, results, reference);
+  }
+  printf("reference loop %.2f ns/byte, deltas are relative to it\n", reference);
+
+  bool regression = false;
+  printf("%-24s %12s %14s %12s %8s\n", "benchmark", "ns/byte", "samples/s", "baseline", "delta");
+  for(size_t i=0;i<results.size();i++)
+  {
+    const Result &r = results[i];
+    printf("%-24s %12.2f %14.0f", r.name.c_str(), r.nsPerByte, r.samplesPerSecond);
+    map<string, BaselineEntry>::iterator b = baseline.find(r.name);
+    if(b != baseline.end())
+    {
+      const double delta = deltaOf(r, b->second);
+      const char *note = "";
+      if(!r.gated) note = "  (info, file I/O)";
+      else if(delta > tolerance) note = "  REGRESSION";
+      else if(delta < -tolerance) note = "  faster, baseline stale";
+      printf(" %12.2f %+7.1f%%%s", b->second.nsPerByte, delta, note);
+      regression |= r.gated && delta > tolerance;
+    }
+    else if(baselinePath && r.gated)
+    {
+      printf("  not in baseline");
+    }
+    printf("\n");
+  }
+
+  if(writePath)
+  {
+    ofstream out(writePath);
+    out << "# hex2wav benchmark baseline, best of several runs" << endl;
+    out << "# name ns_per_byte relative_to_reference_loop (only the relative value is compared)" << endl;
+    for(size_t i=0;i<results.size();i++)
+    {
+      out << results[i].name << " " << results[i].nsPerByte << " " << results[i].relative << endl;
+    }
+  }
+
+  return regression ? 1 : 0;
+}
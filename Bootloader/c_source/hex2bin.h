@@ -11,6 +11,9 @@
 */
 
 
+#ifndef HEX2BIN_H_
+#define HEX2BIN_H_
+
 #include <stdio.h>
 #include <string.h>
 
@@ -40,31 +43,35 @@ public:
   /* this loads an intel hex file into the memory[] array */
   /* loads an intel hex file into the global memory[] array */
   /* filename is a string of the file to be opened */
-  void load_file(char *filename)
+  /* returns false if the file can't be read, has a bad line or no end of file record */
+  bool load_file(char *filename)
   {
 	  char line[1000];
 	  FILE *fin;
 	  int addr, n, status, bytes[256];
-	  int i, total=0, lineno=1;
+	  int i, total=0, lineno=1, errors=0;
 	  minaddr=65536, maxaddr=0;
 
 	  if (strlen(filename) == 0) {
 		  printf("   Can't load a file without the filename.");
 		  printf("  '?' for help\n");
-		  return;
+		  return false;
 	  }
 	  fin = fopen(filename, "r");
 	  if (fin == NULL) {
 		  printf("   Can't open file '%s' for reading.\n", filename);
-		  return;
+		  return false;
 	  }
-	  while (!feof(fin) && !ferror(fin)) {
-		  line[0] = '\0';
-		  fgets(line, 1000, fin);
-		  if (line[strlen(line)-1] == '\n') line[strlen(line)-1] = '\0';
-		  if (line[strlen(line)-1] == '\r') line[strlen(line)-1] = '\0';
+	  while (fgets(line, 1000, fin) != NULL) {
+		  if (strlen(line) && line[strlen(line)-1] == '\n') line[strlen(line)-1] = '\0';
+		  if (strlen(line) && line[strlen(line)-1] == '\r') line[strlen(line)-1] = '\0';
 		  if (parse_hex_line(line, bytes, &addr, &n, &status)) {
 			  if (status == 0) {  /* data */
+				  if (addr + n > 65536) {
+					  printf("   Error: '%s', line: %d, data beyond 64k\n", filename, lineno);
+					  errors++;
+					  n = 0;
+				  }
 				  for(i=0; i<=(n-1); i++) {
 					  memory[addr] = bytes[i] & 255;
 					  total++;
@@ -77,14 +84,18 @@ public:
 				  fclose(fin);
 				  printf("   Loaded %d bytes between:", total);
 				  printf(" %04X to %04X from hex file\n", minaddr, maxaddr);
-				  return;
+				  return errors == 0;
 			  }
 			  if (status == 2){} ;  /* begin of file */
 		  } else {
 			  printf("   Error: '%s', line: %d\n", filename, lineno);
+			  errors++;
 		  }
 		  lineno++;
 	  }
+	  fclose(fin);
+	  printf("   Error: '%s' has no end of file record\n", filename);
+	  return false;
   }
 private:
   /* this is used by load_file to get each line of intex hex */
@@ -127,14 +138,4 @@ private:
   int minaddr, maxaddr;
 };
 
-
-
-
-
-
-
-
-
-
-
-
+#endif /* HEX2BIN_H_ */
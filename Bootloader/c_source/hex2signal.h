@@ -2,7 +2,7 @@
  * 
 	wave generator for audio bootloader
 	
-	hex values to audio signal converter  (manchester code)
+	hex values to audio signal converter  (manchester code and friends)
 	
 	(c) -C-H-R-I-S-T-O-P-H-   -H-A-B-E-R-E-R- 2011
 
@@ -14,23 +14,77 @@
  	Ported to C++ by julian Schmidt 2014
 */
 
+#ifndef HEX2SIGNAL_H_
+#define HEX2SIGNAL_H_
+
 #include <vector>
 
 #include <stdlib.h>   
 using namespace std;
 
+/* Line codes
+ * Each policy turns one bit into samplesPerBit samples, written as two half bits
+ * so the encode loop has no per sample branches. Policies carry their own state
+ * (current level); a fresh policy is used for every frame.
+ *
+ * The Penrose audio bootloader decodes (inverted) differential manchester only,
+ * the other codes are for receivers built around them.
+ */
+enum LineCode {
+	LINE_CODE_DIFFERENTIAL_MANCHESTER = 0,
+	LINE_CODE_MANCHESTER,
+	LINE_CODE_BIPHASE_MARK,
+	NUM_LINE_CODES
+};
+
+// differential manchester code ( inverted ): 1 bit toggles at the bit start, every bit toggles in the middle
+struct DifferentialManchesterCode {
+	double phase;
+	DifferentialManchesterCode() : phase(1) {}
+
+	void bit(bool flag, double *out, int halfBit)
+	{
+		if(flag) phase=-phase;
+		for(int n=0;n<halfBit;n++) out[n]=phase;
+		phase=-phase;
+		for(int n=0;n<halfBit;n++) out[halfBit+n]=phase;
+	}
+};
+
+// manchester code, 1 bit = rising edge, 0 bit = falling edge
+struct ManchesterCode {
+	static const bool invertSignal=true; // correction of an inverted audio signal line
+
+	void bit(bool flag, double *out, int halfBit)
+	{
+		double value = flag ? 1 : -1;
+		if(invertSignal) value=-value;
+		for(int n=0;n<halfBit;n++) out[n]=-value;
+		for(int n=0;n<halfBit;n++) out[halfBit+n]=value;
+	}
+};
+
+// biphase mark code: every bit toggles at the bit start, 1 bits toggle again in the middle
+struct BiphaseMarkCode {
+	double level;
+	BiphaseMarkCode() : level(1) {}
+
+	void bit(bool flag, double *out, int halfBit)
+	{
+		level=-level;
+		for(int n=0;n<halfBit;n++) out[n]=level;
+		if(flag) level=-level;
+		for(int n=0;n<halfBit;n++) out[halfBit+n]=level;
+	}
+};
+
 class HexToSignal {
   
 public:
-  HexToSignal()
+  explicit HexToSignal(LineCode lineCode = LINE_CODE_DIFFERENTIAL_MANCHESTER)
   {
-	lowNumberOfPulses=2;
-	highNumberOfPulses=3;
 	startSequencePulses=40;
-	numStartBits=1;
-	numStopBits=1;
-	invertSignal=true; // correction of an inverted audio signal line
-	manchesterPhase=1; // current phase for differential manchester coding
+	this->lineCode=lineCode;
 	
 	manchesterNumberOfSamplesPerBit=4; // this value must be even
   }
@@ -39,93 +93,91 @@ public:
   }
 
 public:
+	// number of samples manchesterCoding() produces for inputSize bytes
+	int getSignalLength(int inputSize)
+	{
+		return (1+startSequencePulses+inputSize*8)*manchesterNumberOfSamplesPerBit;
+	}
+
+	int getSamplesPerBit()
+	{
+		return manchesterNumberOfSamplesPerBit;
+	}
+	int getStartSequencePulses()
+	{
+		return startSequencePulses;
+	}
+	LineCode getLineCode()
+	{
+		return lineCode;
+	}
+
+	static const char *getLineCodeName(LineCode lineCode)
+	{
+		switch(lineCode)
+		{
+		case LINE_CODE_MANCHESTER:	return "manchester";
+		case LINE_CODE_BIPHASE_MARK:	return "bmc";
+		default:			return "diffmanchester";
+		}
+	}
+
+	// encodes a frame with the line code selected in the constructor
 	void manchesterCoding(std::vector<int> &hexdata, int inputSize, std::vector<double> &outPtr)
 	{
-	  
+		switch(lineCode)
+		{
+		case LINE_CODE_MANCHESTER:
+			encode<ManchesterCode>(hexdata, inputSize, outPtr);
+			break;
+		case LINE_CODE_BIPHASE_MARK:
+			encode<BiphaseMarkCode>(hexdata, inputSize, outPtr);
+			break;
+		default:
+			encode<DifferentialManchesterCode>(hexdata, inputSize, outPtr);
+			break;
+		}
+	}
 
-		int laenge=inputSize;
-		int size = (1+startSequencePulses+laenge*8)*manchesterNumberOfSamplesPerBit;
-		
+	template <typename Code>
+	void encode(std::vector<int> &hexdata, int inputSize, std::vector<double> &outPtr)
+	{
+		Code code;
+		const int halfBit = manchesterNumberOfSamplesPerBit/2;
 
-		//outPtr=new double[size];
-		//double[] signal=new double[(1+startSequencePulses+laenge*8)*manchesterNumberOfSamplesPerBit];
-		outPtr.resize(size);
+		outPtr.resize(getSignalLength(inputSize));
+		double *out = &outPtr[0];
 
-		
-		int counter=0;
 		/** generate synchronisation start sequence **/
 		for (int n=0; n<startSequencePulses; n++)
 		{
-			manchesterEdge(false,counter,outPtr); // 0 bits: generate falling edges 
-			counter+=manchesterNumberOfSamplesPerBit;
+			code.bit(false, out, halfBit); // 0 bits
+			out+=manchesterNumberOfSamplesPerBit;
 		}
 		
 		/** start bit **/
-		manchesterEdge(true,counter,outPtr); //  1 bit:  rising edge 
-		counter+=manchesterNumberOfSamplesPerBit;
+		code.bit(true, out, halfBit);
+		out+=manchesterNumberOfSamplesPerBit;
 		
 		/** create data signal **/
-		int count=0;
-		for(count=0;count<laenge;count++)
+		for(int count=0;count<inputSize;count++)
 		{
 			int dat=hexdata[count];
-			//System.out.println(dat);
 			/** create one byte **/			
 			for( int n=0;n<8;n++) // first bit to send: MSB
 			{
-				if((dat&0x80)==0) 	manchesterEdge(false,counter,outPtr); // generate falling edges ( 0 bits )
-				else 				manchesterEdge(true,counter,outPtr); // rising edge ( 1 bit )
-				counter+=manchesterNumberOfSamplesPerBit;	
+				code.bit((dat&0x80)!=0, out, halfBit);
+				out+=manchesterNumberOfSamplesPerBit;	
 				dat=dat<<1; // shift to next bit
 			}
 		}
-	
 	}
 	
 private:
-	int lowNumberOfPulses;
-	int highNumberOfPulses;
 	int startSequencePulses;
-	int numStartBits;
-	int numStopBits;
-	bool invertSignal; // correction of an inverted audio signal line
-	double manchesterPhase; // current phase for differential manchester coding
+	LineCode lineCode;
 	
 	int manchesterNumberOfSamplesPerBit; // this value must be even
-	/* flag=true: rising edge
-	 * flag=false: falling edge
-	 */
-	void manchesterEdge(bool flag, int pointerIntoSignal,std::vector<double>  &signal )
-	{
-		//double sigpart[]=new double[manchesterNumberOfSamplesPerBit];
-		int n;
-		double value;
-
-		if(false) // manchester code
-		{
-			if(flag) value=1;
-			else value=-1;
-			if(invertSignal)value=value*-1;  // correction of an inverted audio signal line
-			for(n=0;n<manchesterNumberOfSamplesPerBit;n++)
-			{
-				if(n<manchesterNumberOfSamplesPerBit/2)signal[pointerIntoSignal]=-value;
-				else signal[pointerIntoSignal]=value;
-				pointerIntoSignal++;
-			}
-		}
-		else // differential manchester code ( inverted )
-		{
-			if(flag) manchesterPhase=-manchesterPhase; // toggle phase
-			for(n=0;n<manchesterNumberOfSamplesPerBit;n++)
-			{
-				if(n==(manchesterNumberOfSamplesPerBit/2))manchesterPhase=-manchesterPhase; // toggle phase
-				signal[pointerIntoSignal]=manchesterPhase;
-				pointerIntoSignal++;
-			}		
-		}
-		//return sigpart;
-	}
-
-	
 };
- 
+
+#endif /* HEX2SIGNAL_H_ */
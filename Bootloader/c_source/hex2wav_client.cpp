@@ -0,0 +1,123 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	hex2wav-client: sends a conversion request to hex2wavd
+
+	usage: hex2wav-client [-s socket] [--line-code CODE] input.hex|input.elf output.wav|-
+	'-' writes raw 16 bit PCM to stdout, e.g. to pipe it into aplay
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+#include "Hex2WavEncoder.h"
+#include "ImageLoader.h"
+#include "DaemonProtocol.h"
+
+static void usage()
+{
+  cerr << "usage: hex2wav-client [-s socket] [--line-code CODE] input.hex|input.elf output.wav|-" << endl;
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *socketPath = daemonSocketPath();
+  int lineCode = LINE_CODE_DIFFERENTIAL_MANCHESTER;
+
+  int arg = 1;
+  for(; arg < argc && argv[arg][0] == '-' && argv[arg][1] != 0; arg++)
+  {
+    if(strcmp(argv[arg], "-s") == 0 && arg+1 < argc) socketPath = argv[++arg];
+    else if(strcmp(argv[arg], "--line-code") == 0 && arg+1 < argc)
+    {
+      arg++;
+      for(lineCode=0; lineCode<NUM_LINE_CODES; lineCode++)
+      {
+        if(strcmp(argv[arg], HexToSignal::getLineCodeName((LineCode)lineCode)) == 0) break;
+      }
+      if(lineCode == NUM_LINE_CODES) usage();
+    }
+    else usage();
+  }
+  if(argc - arg < 2) usage();
+  const char *input = argv[arg];
+  const char *output = argv[arg+1];
+
+  // keep stdout clean for the PCM stream, loader messages go to stderr
+  FILE *pcmOut = stdout;
+  if(strcmp(output, "-") == 0)
+  {
+    pcmOut = fdopen(dup(1), "wb");
+    dup2(2, 1);
+  }
+
+  std::vector<uint8_t> image;
+  if(!loadFlashImage(input, image)) exit(1);
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path)-1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+  {
+    perror(socketPath);
+    exit(1);
+  }
+
+  DaemonRequest request;
+  request.lineCode = lineCode;
+  request.sampleRate = Hex2WavEncoder::DEFAULT_SAMPLE_RATE;
+  request.imageSize = image.size();
+  if(!writeRequest(fd, request) || (image.size() && !writeAll(fd, &image[0], image.size())))
+  {
+    cerr << "sending request failed" << endl;
+    exit(1);
+  }
+
+  DaemonResponse response = DaemonResponse();
+  if(!readResponse(fd, response))
+  {
+    cerr << "receiving response failed" << endl;
+    exit(1);
+  }
+  if(response.status != DAEMON_OK)
+  {
+    cerr << "request failed, status " << response.status << endl;
+    exit(1);
+  }
+
+  WavFileSink wavSink(output);
+  RawPcmSink rawSink(pcmOut);
+  SampleSink &sink = pcmOut != stdout ? (SampleSink&)rawSink : (SampleSink&)wavSink;
+
+  if(!sink.begin(response.sampleRate, 1, response.samples)) exit(1);
+  short block[Hex2WavEncoder::DEFAULT_BLOCK_SIZE];
+  for(size_t remaining=response.samples; remaining>0;)
+  {
+    size_t n = remaining < Hex2WavEncoder::DEFAULT_BLOCK_SIZE ? remaining : Hex2WavEncoder::DEFAULT_BLOCK_SIZE;
+    if(!readAll(fd, block, n * sizeof(short)) || !sink.write(block, n))
+    {
+      cerr << "receiving samples failed" << endl;
+      exit(1);
+    }
+    remaining -= n;
+  }
+  close(fd);
+  exit(sink.end() ? 0 : 1);
+}
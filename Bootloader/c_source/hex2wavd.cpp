@@ -0,0 +1,239 @@
+/*
+ *
+	wave generator for audio bootloader
+
+	hex2wavd: long running conversion daemon for factory stations
+
+	Listens on a unix domain socket (see DaemonProtocol.h), encodes flash images
+	and streams the PCM back. Recent outputs are kept in an in-memory LRU, so
+	repeated jobs skip the encoder entirely. Requests are handled one at a time.
+
+	usage: hex2wavd [-s socket] [-m lru size in MB] [--cache DIR] [-v]
+
+	This program is free software; you can redistribute it and/or modify
+ 	it under the terms of the GNU General Public License as published by
+ 	the Free Software Foundation; either version 2 of the License, or
+ 	(at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "Hex2WavEncoder.h"
+#include "DaemonProtocol.h"
+
+// recently generated outputs, bounded by total sample memory
+class OutputLru {
+public:
+  typedef std::shared_ptr<const std::vector<short> > Entry;
+
+  explicit OutputLru(size_t capacityBytes) : capacityBytes(capacityBytes), usedBytes(0) {}
+
+  Entry get(uint64_t key)
+  {
+	  std::map<uint64_t, List::iterator>::iterator it = index.find(key);
+	  if(it == index.end()) return Entry();
+	  entries.splice(entries.begin(), entries, it->second);
+	  return it->second->second;
+  }
+
+  void put(uint64_t key, Entry entry)
+  {
+	  const size_t bytes = entry->size() * sizeof(short);
+	  if(bytes > capacityBytes || index.count(key)) return;
+	  while(usedBytes + bytes > capacityBytes)
+	  {
+		  usedBytes -= entries.back().second->size() * sizeof(short);
+		  index.erase(entries.back().first);
+		  entries.pop_back();
+	  }
+	  entries.push_front(std::make_pair(key, entry));
+	  index[key] = entries.begin();
+	  usedBytes += bytes;
+  }
+
+  size_t size() const { return entries.size(); }
+  size_t capacity() const { return capacityBytes; }
+
+private:
+  typedef std::list<std::pair<uint64_t, Entry> > List;
+  List entries;
+  std::map<uint64_t, List::iterator> index;
+  size_t capacityBytes;
+  size_t usedBytes;
+};
+
+static bool verbose = false;
+
+//-----------------------------------------------------------
+static void handleClient(int fd, OutputLru &lru, EncoderCache *cache)
+{
+  DaemonRequest request;
+  DaemonResponse response;
+  response.status = DAEMON_OK;
+  response.sampleRate = 0;
+  response.samples = 0;
+
+  if(!readRequest(fd, request))
+  {
+    response.status = DAEMON_BAD_REQUEST;
+    writeResponse(fd, response);
+    return;
+  }
+  if(request.imageSize > HEX2WAVD_MAX_IMAGE)
+  {
+    response.status = DAEMON_IMAGE_TOO_LARGE;
+    writeResponse(fd, response);
+    return;
+  }
+
+  // the image is read first, the client only looks for the response once it is sent
+  std::vector<uint8_t> image(request.imageSize);
+  if(request.imageSize && !readAll(fd, &image[0], image.size())) return;
+
+  if(request.lineCode >= NUM_LINE_CODES ||
+     request.sampleRate < HEX2WAVD_MIN_SAMPLE_RATE || request.sampleRate > HEX2WAVD_MAX_SAMPLE_RATE)
+  {
+    response.status = DAEMON_BAD_REQUEST;
+    writeResponse(fd, response);
+    return;
+  }
+
+  Hex2WavEncoder encoder(image, request.sampleRate);
+  encoder.setLineCode((LineCode)request.lineCode);
+  encoder.setCache(cache);
+
+  // the response carries the length as uint32, the copy for the LRU is bounded too
+  const size_t totalSamples = encoder.getTotalSamples();
+  if(totalSamples > HEX2WAVD_MAX_SAMPLES)
+  {
+    response.status = DAEMON_OUTPUT_TOO_LARGE;
+    writeResponse(fd, response);
+    return;
+  }
+
+  const uint64_t key = encoder.getOutputKey();
+  OutputLru::Entry cached = lru.get(key);
+
+  // a copy is only kept if the LRU can take it, allocated before the response is sent
+  std::shared_ptr<std::vector<short> > output;
+  if(!cached && totalSamples * sizeof(short) <= lru.capacity())
+  {
+    try
+    {
+      output.reset(new std::vector<short>());
+      output->reserve(totalSamples);
+    }
+    catch(const std::bad_alloc &)
+    {
+      response.status = DAEMON_OUT_OF_MEMORY;
+      writeResponse(fd, response);
+      return;
+    }
+  }
+
+  response.sampleRate = request.sampleRate;
+  response.samples = (uint32_t)totalSamples;
+  if(!writeResponse(fd, response)) return;
+
+  if(cached)
+  {
+    if(verbose) cout << "hit  " << hex << key << dec << ", " << cached->size() << " samples" << endl;
+    writeAll(fd, &(*cached)[0], cached->size() * sizeof(short));
+    return;
+  }
+
+  // stream blocks as they are encoded
+  short block[Hex2WavEncoder::DEFAULT_BLOCK_SIZE];
+  size_t n;
+  while((n = encoder.read(block, Hex2WavEncoder::DEFAULT_BLOCK_SIZE)) > 0)
+  {
+    if(!writeAll(fd, block, n * sizeof(short))) return;
+    if(output) output->insert(output->end(), block, block + n);
+  }
+  if(!output) return;
+  lru.put(key, output);
+  if(verbose) cout << "miss " << hex << key << dec << ", " << output->size() << " samples, " << lru.size() << " cached" << endl;
+}
+//-----------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  const char *socketPath = daemonSocketPath();
+  size_t lruMegabytes = 64;
+  const char *cacheDir = NULL;
+
+  for(int i=1;i<argc;i++)
+  {
+    if(strcmp(argv[i], "-s") == 0 && i+1 < argc) socketPath = argv[++i];
+    else if(strcmp(argv[i], "-m") == 0 && i+1 < argc) lruMegabytes = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--cache") == 0 && i+1 < argc) cacheDir = argv[++i];
+    else if(strcmp(argv[i], "-v") == 0) verbose = true;
+    else
+    {
+      cout << "usage: hex2wavd [-s socket] [-m lru size in MB] [--cache DIR] [-v]" << endl;
+      exit(1);
+    }
+  }
+
+  // a client going away mid stream must not kill the daemon
+  signal(SIGPIPE, SIG_IGN);
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(strlen(socketPath) >= sizeof(addr.sun_path))
+  {
+    cout << "socket path too long: " << socketPath << endl;
+    exit(1);
+  }
+  strcpy(addr.sun_path, socketPath);
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socketPath);
+  if(server < 0 || bind(server, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(server, 16) != 0)
+  {
+    perror("hex2wavd");
+    exit(1);
+  }
+
+  OutputLru lru(lruMegabytes * 1024 * 1024);
+  std::unique_ptr<EncoderCache> cache;
+  if(cacheDir) cache.reset(new EncoderCache(cacheDir));
+
+  cout << "hex2wavd listening on " << socketPath << endl;
+  while(1)
+  {
+    int client = accept(server, NULL, NULL);
+    if(client < 0) continue;
+
+    // a stalled client must not block the station forever
+    struct timeval timeout = { 10, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // allocation failures past the response header drop this connection only
+    try
+    {
+      handleClient(client, lru, cache.get());
+    }
+    catch(const std::bad_alloc &)
+    {
+      cout << "out of memory, request dropped" << endl;
+    }
+    close(client);
+  }
+}
@@ -24,20 +24,121 @@
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>   
+#include <string.h>
 using namespace std;
 #include "WaveCodeGenerator.h"
  
+static void usage()
+{
+  cout << "you need to call 'hex2wav [options] input.hex output.wav'" << endl;
+  cout << "or 'hex2wav [options] -m output.wav input1.hex input2.hex ...' for one module per channel" << endl;
+  cout << "or 'hex2wav --expand input.rlpc output.wav' to unpack a compact file" << endl;
+  cout << "options:" << endl;
+  cout << "  --cache DIR          reuse generated files and encoded pages from DIR (default: $HEX2WAV_CACHE)" << endl;
+  cout << "  --line-code CODE     diffmanchester (default, understood by the bootloader), manchester or bmc" << endl;
+  cout << "  --format FORMAT      wav (default) or rlpc, a lossless run length container" << endl;
+  cout << "  --threads N          page encoder threads for .wav output (default: one per cpu)" << endl;
+  cout << "  --stats              print per stage timings, throughput and flash duration" << endl;
+  cout << "  --stats-json FILE    write the same report as JSON to FILE" << endl;
+}
+
 int main(int argc,char *argv[]){
 
+  WavCodeGenerator waveGenerator;
+  bool multiChannel = false;
+  bool expand = false;
+  bool printStats = false;
+  std::string statsJson;
+
+  if (getenv("HEX2WAV_CACHE")) waveGenerator.setCacheDir(getenv("HEX2WAV_CACHE"));
+
+  //parse options
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; arg++)
+  {
+    if (strcmp(argv[arg], "-m") == 0)
+    {
+      multiChannel = true;
+    }
+    else if (strcmp(argv[arg], "--cache") == 0 && arg+1 < argc)
+    {
+      waveGenerator.setCacheDir(argv[++arg]);
+    }
+    else if (strcmp(argv[arg], "--line-code") == 0 && arg+1 < argc)
+    {
+      arg++;
+      int code = 0;
+      for (; code < NUM_LINE_CODES; code++)
+      {
+        if (strcmp(argv[arg], HexToSignal::getLineCodeName((LineCode)code)) == 0) break;
+      }
+      if (code == NUM_LINE_CODES)
+      {
+        cout << "unknown line code '" << argv[arg] << "'" << endl;
+        usage();
+        exit(1);
+      }
+      waveGenerator.setLineCode((LineCode)code);
+    }
+    else if (strcmp(argv[arg], "--format") == 0 && arg+1 < argc)
+    {
+      arg++;
+      if (strcmp(argv[arg], "wav") == 0) waveGenerator.setOutputFormat(WavCodeGenerator::FORMAT_WAV);
+      else if (strcmp(argv[arg], "rlpc") == 0) waveGenerator.setOutputFormat(WavCodeGenerator::FORMAT_RLPC);
+      else
+      {
+        cout << "unknown format '" << argv[arg] << "'" << endl;
+        usage();
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[arg], "--threads") == 0 && arg+1 < argc)
+    {
+      waveGenerator.setThreads(atoi(argv[++arg]));
+    }
+    else if (strcmp(argv[arg], "--expand") == 0)
+    {
+      expand = true;
+    }
+    else if (strcmp(argv[arg], "--stats") == 0)
+    {
+      printStats = true;
+    }
+    else if (strcmp(argv[arg], "--stats-json") == 0 && arg+1 < argc)
+    {
+      statsJson = argv[++arg];
+    }
+    else
+    {
+      cout << "unknown option '" << argv[arg] << "'" << endl;
+      usage();
+      exit(1);
+    }
+  }
+
+  waveGenerator.setStats(printStats, statsJson);
+
   //check if arguments are valid
-  if (argc < 3)
+  if (argc - arg < 2)
   {
-    cout << "not enough arguments!" << endl << "you need to call 'hex2wav input.hex output.wav'" << endl;
+    cout << "not enough arguments!" << endl;
+    usage();
     exit(1);
   }
   
-  WavCodeGenerator waveGenerator;
-  waveGenerator.convertHex2Wav(argv[1], argv[2]);
+  if (expand)
+  {
+    if(!waveGenerator.expandRlpc2Wav(argv[arg], argv[arg+1])) exit(1);
+  }
+  else if (multiChannel)
+  {
+    std::vector<char*> hexFiles(argv + arg + 1, argv + argc);
+    if(!waveGenerator.convertHexes2Wav(hexFiles, argv[arg])) exit(1);
+  }
+  else
+  {
+    if(!waveGenerator.convertHex2Wav(argv[arg], argv[arg+1])) exit(1);
+  }
 
   exit(0);
 }
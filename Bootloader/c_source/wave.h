@@ -2,7 +2,11 @@
  * http://joshparnell.com/blog/2013/03/21/how-to-write-a-wav-file-in-c/
  * */
 
+#ifndef WAVE_H_
+#define WAVE_H_
+
 #include <fstream>
+#include <string.h>
 
 template <typename T>
 void write(std::ofstream& stream, const T& t) {
@@ -15,19 +19,17 @@ void writeFormat(std::ofstream& stream) {
 }
 
 template <>
-void writeFormat<float>(std::ofstream& stream) {
+inline void writeFormat<float>(std::ofstream& stream) {
   write<short>(stream, 3);
 }
 
 template <typename SampleType>
-void writeWAVData(
-  char const* outFile,
-  SampleType* buf,
+void writeWAVHeader(
+  std::ofstream& stream,
   size_t bufSize,
   int sampleRate,
   short channels)
 {
-  std::ofstream stream(outFile, std::ios::binary);
   stream.write("RIFF", 4);
   write<int>(stream, 36 + bufSize);
   stream.write("WAVE", 4);
@@ -41,6 +43,55 @@ void writeWAVData(
   write<short>(stream, 8 * sizeof(SampleType));                   // Bits per sample
   stream.write("data", 4);
   stream.write((const char*)&bufSize, 4);
+}
+
+template <typename T>
+inline short wavFormat() {
+  return 1;
+}
+
+template <>
+inline short wavFormat<float>() {
+  return 3;
+}
+
+// same header as above, written to memory (44 bytes)
+template <typename SampleType>
+void writeWAVHeader(
+  char* dst,
+  size_t bufSize,
+  int sampleRate,
+  short channels)
+{
+  int riffSize = 36 + bufSize;
+  int fmtSize = 16;
+  short format = wavFormat<SampleType>();
+  int byteRate = sampleRate * channels * sizeof(SampleType);
+  short frameSize = channels * sizeof(SampleType);
+  short bits = 8 * sizeof(SampleType);
+  int dataSize = bufSize;
+
+  memcpy(dst, "RIFF", 4);             memcpy(dst+4, &riffSize, 4);
+  memcpy(dst+8, "WAVE", 4);           memcpy(dst+12, "fmt ", 4);
+  memcpy(dst+16, &fmtSize, 4);        memcpy(dst+20, &format, 2);
+  memcpy(dst+22, &channels, 2);       memcpy(dst+24, &sampleRate, 4);
+  memcpy(dst+28, &byteRate, 4);       memcpy(dst+32, &frameSize, 2);
+  memcpy(dst+34, &bits, 2);           memcpy(dst+36, "data", 4);
+  memcpy(dst+40, &dataSize, 4);
+}
+
+template <typename SampleType>
+void writeWAVData(
+  char const* outFile,
+  SampleType* buf,
+  size_t bufSize,
+  int sampleRate,
+  short channels)
+{
+  std::ofstream stream(outFile, std::ios::binary);
+  writeWAVHeader<SampleType>(stream, bufSize, sampleRate, channels);
   stream.write((const char*)buf, bufSize);
 }
+
+#endif /* WAVE_H_ */
  
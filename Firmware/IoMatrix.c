@@ -21,8 +21,8 @@
  */ 
 
 #include "IoMatrix.h"
-#include <util/delay.h>
 #include <avr/pgmspace.h> 
+#include <avr/interrupt.h>
 #include "spi.h"
 #include "timebase.h"
 
@@ -42,24 +42,220 @@ led	pin A	Pin B
 10	4	6
 11	5	6
 */
-static const uint8_t ledPinArray[12][2] PROGMEM = {
-  {LED_1_PIN,LED_2_PIN},
-  {LED_1_PIN,LED_3_PIN},
-  {LED_1_PIN,LED_4_PIN},
-  {LED_2_PIN,LED_3_PIN},
-  {LED_2_PIN,LED_4_PIN},
-  {LED_2_PIN,LED_5_PIN},
-  {LED_3_PIN,LED_4_PIN},
-  {LED_3_PIN,LED_5_PIN},
-  {LED_3_PIN,LED_6_PIN},
-  {LED_4_PIN,LED_5_PIN},
-  {LED_4_PIN,LED_6_PIN},
-  {LED_5_PIN,LED_6_PIN},
+/* DDR and PORT bits of both LED ports for each LED and colour, used by the refresh ISR
+ * the LED pins of port C (1-3) and port D (4-6) use different bits
+ * so one byte holds both ports and every register gets a single write.
+ * colour 0 (playing) drives pin A high, colour 1 (active step) pin B
+ */
+#define LED_MASK_13 ((1<<LED_1_PIN) | (1<<LED_2_PIN) | (1<<LED_3_PIN))
+#define LED_MASK_46 ((1<<LED_4_PIN) | (1<<LED_5_PIN) | (1<<LED_6_PIN))
+#if (LED_MASK_13 & LED_MASK_46)
+#error "LED pins of both ports must use different bits"
+#endif
+#define LED_ENTRY(a,b) {{(1<<(a))|(1<<(b)), (1<<(a))}, {(1<<(a))|(1<<(b)), (1<<(b))}}
+static const uint8_t ledMaskArray[12][2][2] PROGMEM = {
+  LED_ENTRY(LED_1_PIN,LED_2_PIN),
+  LED_ENTRY(LED_1_PIN,LED_3_PIN),
+  LED_ENTRY(LED_1_PIN,LED_4_PIN),
+  LED_ENTRY(LED_2_PIN,LED_3_PIN),
+  LED_ENTRY(LED_2_PIN,LED_4_PIN),
+  LED_ENTRY(LED_2_PIN,LED_5_PIN),
+  LED_ENTRY(LED_3_PIN,LED_4_PIN),
+  LED_ENTRY(LED_3_PIN,LED_5_PIN),
+  LED_ENTRY(LED_3_PIN,LED_6_PIN),
+  LED_ENTRY(LED_4_PIN,LED_5_PIN),
+  LED_ENTRY(LED_4_PIN,LED_6_PIN),
+  LED_ENTRY(LED_5_PIN,LED_6_PIN),
 };
 //-----------------------------------------------------------
 static uint16_t io_ledState=0xfff;		//state of the 12 LEDs == activated notes
 static uint8_t io_activeStep=2;			//current active quantisation step == currently played note
-static uint16_t io_lastButtonState=0x00;
+static uint8_t io_stepOffset[12] = {0,0,0,0,0,0,0,0,0,0,0,0};	//matches io_ledState=0xfff
+static uint8_t io_stepOffsetDown[12] = {0,0,0,0,0,0,0,0,0,0,0,0};
+static uint8_t io_quantMode = QUANT_MODE_UP;
+static volatile uint8_t io_frame[12];		//LED frame buffer, colour<<7 | level
+static uint8_t io_refreshLed = 0;		//LED lit by the refresh ISR
+static uint8_t io_refreshSub = 0;		//sub slot of io_refreshLed
+
+//button matrix scan, one column per LED slot
+static volatile uint8_t io_matrixLocked = 0;	//the SPI port uses the matrix pins
+static uint8_t io_scanCol = 0;			//column driven low
+static uint8_t io_scanDriven = 0;		//io_scanCol was driven during the last slot, its rows settled
+static uint16_t io_scanSample = 0;		//raw button states of the current scan, 1 = pushed
+
+//debounced buttons, bit = button nr
+static uint16_t io_keyState = 0;		//debounced state, 1 = pushed
+static uint16_t io_keyCt0 = 0xffff;		//2 bit vertical counters, one per button
+static uint16_t io_keyCt1 = 0xffff;
+static uint16_t io_longCounter = 0;		//scans io_keyState did not change
+static volatile uint16_t io_keyPress = 0;	//events, cleared by io_getKey...()
+static volatile uint16_t io_keyRelease = 0;
+static volatile uint16_t io_keyLong = 0;
+//-----------------------------------------------------------
+//frame buffer from the active steps and the played note
+static void updateFrame()
+{
+  for(uint8_t i=0;i<12;i++)
+  {
+    if(i==io_activeStep)
+    {
+      //this step is currently played => colour 1
+      io_frame[i] = LED_LEVEL_PLAYING;
+    }
+    else if(io_ledState & (1<<i))
+    {
+      //step is active => colour 2
+      io_frame[i] = 0x80 | (io_quantMode==QUANT_MODE_NEAREST ? LED_LEVEL_NEAREST : LED_LEVEL_ACTIVE);
+    }
+    else
+    {
+      io_frame[i] = 0;
+    }
+  }
+}
+//-----------------------------------------------------------
+/* debounce all 12 buttons at once with vertical counters
+ * a button has to read the same for 4 scans (4 * 1.8ms) before its state changes
+ */
+static inline void debounceButtons(uint16_t sample)
+{
+  uint16_t changed = io_keyState ^ sample;
+  //count down while the sample differs from the state, reset to 3 otherwise
+  io_keyCt0 = ~(io_keyCt0 & changed);
+  io_keyCt1 = io_keyCt0 ^ (io_keyCt1 & changed);
+  //counter rolled over
+  changed &= io_keyCt0 & io_keyCt1;
+  io_keyState ^= changed;
+  
+  io_keyPress |= io_keyState & changed;
+  io_keyRelease |= ~io_keyState & changed;
+  
+  //long press: buttons held without any change for KEY_LONG_SCANS
+  if(changed || !io_keyState)
+  {
+    io_longCounter = 0;
+  }
+  else if(io_longCounter < KEY_LONG_SCANS)
+  {
+    if(++io_longCounter == KEY_LONG_SCANS) io_keyLong |= io_keyState;
+  }
+}
+//-----------------------------------------------------------
+/* one step of the button matrix scan: read the rows of the column driven
+ * during the last LED slot, then drive the next column
+ * skipped while the SPI port has the matrix pins (MISO and SS are row inputs)
+ */
+static inline void scanButtons()
+{
+  if(io_matrixLocked)
+  {
+    io_scanDriven = 0;
+    return;
+  }
+  
+  if(io_scanDriven)
+  {
+    if((SWITCH_INPUT_12 & (1<<SWITCH_ROW1_PIN)) == 0) io_scanSample |= 1<<io_scanCol;
+    if((SWITCH_INPUT_12 & (1<<SWITCH_ROW2_PIN)) == 0) io_scanSample |= 1<<(4+io_scanCol);
+    if((SWITCH_INPUT_3 & (1<<SWITCH_ROW3_PIN)) == 0) io_scanSample |= 1<<(8+io_scanCol);
+    
+    if(++io_scanCol >= 4)
+    {
+      io_scanCol = 0;
+      debounceButtons(io_scanSample);
+      io_scanSample = 0;
+    }
+  }
+  
+  //all columns on, pin low for active column
+  COL_PORT = (COL_PORT | COL_MASK) & ~(1<<io_scanCol);
+  io_scanDriven = 1;
+}
+//-----------------------------------------------------------
+/* LED refresh, every LED gets LED_LEVEL_MAX sub slots per frame
+ * and is lit for as many of them as its level says
+ * 12 * 3 * 150us = 5.4ms = 185Hz frame rate, independent of the main loop
+ */
+ISR(TIMER1_COMPB_vect)
+{
+  //timer 1 runs in CTC mode up to TIMER_TICKS_PER_PERIOD, move the compare point on by one slot
+  uint16_t next = OCR1B + LED_SLOT_TICKS;
+  if(next >= TIMER_TICKS_PER_PERIOD) next -= TIMER_TICKS_PER_PERIOD;
+  OCR1B = next;
+  
+  const uint8_t entry = io_frame[io_refreshLed];
+  uint8_t ddr = 0;
+  uint8_t port = 0;
+  if((entry & 0x7f) > io_refreshSub)
+  {
+    const uint8_t colour = entry >> 7;
+    ddr = pgm_read_byte(&ledMaskArray[io_refreshLed][colour][0]);
+    port = pgm_read_byte(&ledMaskArray[io_refreshLed][colour][1]);
+  }
+  
+  LED_PORT_13 = (LED_PORT_13 & ~LED_MASK_13) | (port & LED_MASK_13);
+  LED_PORT_46 = (LED_PORT_46 & ~LED_MASK_46) | (port & LED_MASK_46);
+  LED_DDR_13 = (LED_DDR_13 & ~LED_MASK_13) | (ddr & LED_MASK_13);
+  LED_DDR_46 = (LED_DDR_46 & ~LED_MASK_46) | (ddr & LED_MASK_46);
+  
+  if(++io_refreshSub >= LED_LEVEL_MAX)
+  {
+    io_refreshSub = 0;
+    if(++io_refreshLed >= 12) io_refreshLed = 0;
+    
+    scanButtons();
+  }
+}
+//-----------------------------------------------------------
+void io_lockMatrix()
+{
+  const uint8_t sreg = SREG;
+  cli();
+  io_matrixLocked = 1;
+  //all columns high, no button can pull a row low
+  COL_PORT |= COL_MASK;
+  SREG = sreg;
+}
+//-----------------------------------------------------------
+void io_unlockMatrix()
+{
+  io_matrixLocked = 0;
+}
+//-----------------------------------------------------------
+//returns and clears the events of the buttons in mask
+static uint16_t takeKeys(volatile uint16_t *keys, uint16_t mask)
+{
+  const uint8_t sreg = SREG;
+  cli();
+  mask &= *keys;
+  *keys ^= mask;
+  SREG = sreg;
+  return mask;
+}
+//-----------------------------------------------------------
+uint16_t io_getKeyPress(uint16_t mask)
+{
+  return takeKeys(&io_keyPress, mask);
+}
+//-----------------------------------------------------------
+uint16_t io_getKeyRelease(uint16_t mask)
+{
+  return takeKeys(&io_keyRelease, mask);
+}
+//-----------------------------------------------------------
+uint16_t io_getKeyLong(uint16_t mask)
+{
+  return takeKeys(&io_keyLong, mask);
+}
+//-----------------------------------------------------------
+uint16_t io_getKeyState()
+{
+  const uint8_t sreg = SREG;
+  cli();
+  const uint16_t state = io_keyState;
+  SREG = sreg;
+  return state;
+}
 //-----------------------------------------------------------
 void io_init()
 {
@@ -77,6 +273,11 @@ void io_init()
   //all buttown columns as outs, state high
   COL_DDR |= (1<<COL1_PIN) | (1<<COL2_PIN) | (1<<COL3_PIN) | (1<<COL4_PIN);
   COL_PORT |= ((1<<COL1_PIN) | (1<<COL2_PIN) | (1<<COL3_PIN) | (1<<COL4_PIN));
+  
+  //LED refresh on the timer 1 compare B interrupt, timer_init() starts timer 1
+  updateFrame();
+  OCR1B = LED_SLOT_TICKS;
+  TIMSK1 |= (1<<OCIE1B);
 };
 //-----------------------------------------------------------
 uint16_t io_getActiveSteps()
@@ -84,276 +285,78 @@ uint16_t io_getActiveSteps()
   return io_ledState;
 }
 //-----------------------------------------------------------
-void io_setActiveSteps(uint16_t val)
-{
-  io_ledState = val;
-}
-//-----------------------------------------------------------
-void io_setCurrentQuantizedValue(uint8_t value)
+uint8_t io_getStepOffset(uint8_t note)
 {
-  io_activeStep = value;
+  return io_stepOffset[note];
 }
 //-----------------------------------------------------------
-void turnAllLedsOff()
+uint8_t io_getStepOffsetDown(uint8_t note)
 {
-  //all pins low / no pullup
-  LED_PORT_13 &= ~( (1<<LED_1_PIN) | (1<<LED_2_PIN) | (1<<LED_3_PIN) );
-  LED_PORT_46 &= ~( (1<<LED_4_PIN) | (1<<LED_5_PIN) | (1<<LED_6_PIN) );
-  
-  //all LED pins as inputs => off
-  LED_DDR_13 &= ~(  (1<<LED_1_PIN) | (1<<LED_2_PIN) | (1<<LED_3_PIN)  );
-  LED_DDR_46 &= ~(  (1<<LED_4_PIN) | (1<<LED_5_PIN) | (1<<LED_6_PIN)  );
+  return io_stepOffsetDown[note];
 }
 //-----------------------------------------------------------
-void turnLedOn(uint16_t ledNr, uint8_t colour)
+/* rebuild the next/previous active step tables for the quantizer
+ * walking down two octaves carries the lowest step of the next octave
+ * into the notes above the highest active step, walking up carries the
+ * highest step of the octave below into the notes under the lowest one
+ * the tables are complete before the new state is visible
+ */
+void io_setActiveSteps(uint16_t val)
 {
-  //get the needed pins from the LED array
-  uint8_t pinA = pgm_read_byte(&ledPinArray[ledNr][0]);
-  uint8_t pinB = pgm_read_byte(&ledPinArray[ledNr][1]);
-  
-  if(colour)
+  uint8_t next = 24;
+  for(int8_t i=23;i>=0;i--)
   {
-    //colour 2 -> A=0, B=1
-    if(pinA > LED_3_PIN)
-    {
-      LED_DDR_46 	|= (1<<pinA);	//pin as output
-      LED_PORT_46	&= ~(1<<pinA);	//pin low
-    }
-    else
-    {
-      LED_DDR_13	|= (1<<pinA);
-      LED_PORT_13	&= ~(1<<pinA);
-    }
-    
-    if(pinB > LED_3_PIN)
-    {
-      LED_DDR_46	|= (1<<pinB);	//pin as output
-      LED_PORT_46 	|= (1<<pinB);	//pin high
-    }
-    else
-    {
-      LED_DDR_13	|= (1<<pinB);
-      LED_PORT_13	|= (1<<pinB);
-    }
+    const uint8_t note = i<12 ? i : i-12;
+    if(val & (1<<note)) next = i;
+    if(i<12) io_stepOffset[i] = next<24 ? next-i : 0;
   }
-  else
+  uint8_t prev = 0xff;
+  for(uint8_t i=0;i<24;i++)
   {
-    //colour 1 -> A out, B in
-    if(pinA > LED_3_PIN)
-    {
-      LED_DDR_46 	|= (1<<pinA);	//pin as output
-      LED_PORT_46	|= (1<<pinA);	//pin high
-    }
-    else
-    {
-      LED_DDR_13	|= (1<<pinA);
-      LED_PORT_13	|= (1<<pinA);
-    }
-    
-    if(pinB > LED_3_PIN)
-    {
-      LED_DDR_46	|= (1<<pinB);	//pin as output
-      LED_PORT_46 	&= ~(1<<pinB);	//pin low
-    }
-    else
-    {
-      LED_DDR_13	|= (1<<pinB);
-      LED_PORT_13	&= ~(1<<pinB);
-    }    
+    const uint8_t note = i<12 ? i : i-12;
+    if(val & (1<<note)) prev = i;
+    if(i>=12) io_stepOffsetDown[note] = prev!=0xff ? i-prev : 0;
   }
+  io_ledState = val;
+  updateFrame();
 }
 //-----------------------------------------------------------
-//one circle trough the whole LED matrix
-void io_processLed()
+uint8_t io_getQuantMode()
 {
-  for(int i=0; i<12; i++)
-  {    
-    if(i==io_activeStep)
-    {
-      //this step is currently played => set color 1
-      turnLedOn(i,0);
-    } 
-    else if ( (io_ledState & (1<<i)) > 0)
-    {
-      //step is active => colour 2
-      turnLedOn(i,1);
-    }
-     _delay_us(300); //otherwise the LEDs are too dark
-    turnAllLedsOff();
-  }
-};
+  return io_quantMode;
+}
 //-----------------------------------------------------------
-static uint8_t ledState = 0;
-void io_processLedPipelined()
+void io_setQuantMode(uint8_t mode)
 {
-  turnAllLedsOff();
-
-  if(ledState==io_activeStep)
-  {
-    //this step is currently played => set color 1
-    turnLedOn(ledState,0);
-  } 
-  else if ( (io_ledState & (1<<ledState)) > 0)
-  {
-    //step is active => colour 2
-    turnLedOn(ledState,1);
-  }
-  
-  ledState++;
-  if(ledState>=12) ledState=0;
-};
+  io_quantMode = mode==QUANT_MODE_NEAREST ? QUANT_MODE_NEAREST : QUANT_MODE_UP;
+  updateFrame();
+}
 //-----------------------------------------------------------
-//read button matrix 
-void io_processButtons()
+void io_setCurrentQuantizedValue(uint8_t value)
 {
-	uint8_t col;
-	uint8_t row;
-	uint8_t i=0;
-	uint16_t val;
-	
-	for(row=0;row<3;row++)
-	{
-	  for(col=0;col<4;col++)
-	  {
-		//all columns on
-		COL_PORT |= ( (1<<COL1_PIN) | (1<<COL2_PIN) | (1<<COL3_PIN) | (1<<COL4_PIN) );
-		//pin low for active column
-		COL_PORT &= ~(1<<col);
-		
-		//read active row input
-		switch(row)
-		{
-		  case 0:
-		      val = (SWITCH_INPUT_12 & (1<<SWITCH_ROW1_PIN) ) == 0;
-		      break;
-		  
-		  case 1:
-		      val = (SWITCH_INPUT_12 & (1<<SWITCH_ROW2_PIN) ) == 0;
-		      break;
-		    
-		  case 2:
-		      val = (SWITCH_INPUT_3 & (1<<SWITCH_ROW3_PIN) ) == 0;
-		      break;
-		}
-	    
-		//check if the button changed its state since the last call
-		if(   (io_lastButtonState&(1<<i))   != (val<<i)   )
-		{
-			//update state memory
-			io_lastButtonState &= ~(1<<i);
-			io_lastButtonState |=val<<i;
-			//toggle LED
-			if(val)
-			{
-			  timer_touchAutosave();
-			  if(!(io_ledState&(1<<i)))
-			  {
-			    io_ledState |= 1<<i;
-			  } else 
-			  {
-			    io_ledState &= ~(1<<i);
-			  }
-			}
-		}
-		i++;
-	  }
-	}
-};
+  if(value == io_activeStep) return;
+  io_activeStep = value;
+  updateFrame();
+}
 //-----------------------------------------------------------
-static uint8_t buttonRowIndex = 0;
-static uint8_t buttonColIndex = 0;
-static uint8_t ledNr = 0;
-
-void io_processButtonsPipelined()
+//toggle the active steps with the debounced button presses
+void io_processButtonEvents()
 {
-	uint8_t i= ledNr;
-	uint16_t val;
-	  
-	//all columns on
-	COL_PORT |= ( (1<<COL1_PIN) | (1<<COL2_PIN) | (1<<COL3_PIN) | (1<<COL4_PIN) );
-	//pin low for active column
-	COL_PORT &= ~(1<<buttonColIndex);
-	
-	//read active row input
-	switch(buttonRowIndex)
+	const uint16_t pressed = io_getKeyPress(KEY_ALL);
+	if(pressed)
 	{
-	  default:
-	  case 0:
-	      val = (SWITCH_INPUT_12 & (1<<SWITCH_ROW1_PIN) ) == 0;
-	      break;
-	  
-	  case 1:
-	      val = (SWITCH_INPUT_12 & (1<<SWITCH_ROW2_PIN) ) == 0;
-	      break;
-	    
-	  case 2:
-	      val = (SWITCH_INPUT_3 & (1<<SWITCH_ROW3_PIN) ) == 0;
-	      break;
+	  timer_touchAutosave();
+	  io_setActiveSteps(io_ledState ^ pressed);
 	}
-    
-	//check if the button changed its state since the last call
-	if(   (io_lastButtonState&(1<<i))   != (val<<i)   )
-	{
-		//update state memory
-		io_lastButtonState &= ~(1<<i);
-		io_lastButtonState |=val<<i;
-		//toggle LED
-		if(val)
-		{
-		  timer_touchAutosave();
-		  if(!(io_ledState&(1<<i)))
-		  {
-		    io_ledState |= 1<<i;
-		  } else 
-		  {
-		    io_ledState &= ~(1<<i);
-		  }
-		}
-	}
-	
-	ledNr++;
 	
-	buttonColIndex++;
-	if(buttonColIndex>=4)
+	//a long press on a single button switches the quantizer mode,
+	//the step its press toggled goes back
+	const uint16_t held = io_getKeyLong(KEY_ALL);
+	if(held && (held & (held-1))==0)
 	{
-	  buttonColIndex=0;
-	  buttonRowIndex++;
-	  if(buttonRowIndex>=3)
-	  {
-	    buttonRowIndex=0;
-	    ledNr = 0;
-	  }
+	  timer_touchAutosave();
+	  io_setActiveSteps(io_ledState ^ held);
+	  io_setQuantMode(io_quantMode ^ 1);
 	}
 }
 //-----------------------------------------------------------
-uint8_t io_isButtonPushed(uint8_t buttonNr)
-{
-  uint8_t row = buttonNr/4; // [0:2]
-  uint8_t col = buttonNr%4; // [0:3]
-
-  //all columns on
-  COL_PORT |= ( (1<<COL1_PIN) | (1<<COL2_PIN) | (1<<COL3_PIN) | (1<<COL4_PIN) );
-  //pin low for active column
-  COL_PORT &= ~(1<<col);
-  
-  //read active row input
-  uint8_t val = 0;
-  switch(row)
-  {
-  case 0:
-      val = (SWITCH_INPUT_12 & (1<<SWITCH_ROW1_PIN) ) == 0;
-      break;
-
-  case 1:
-      val = (SWITCH_INPUT_12 & (1<<SWITCH_ROW2_PIN) ) == 0;
-      break;
-    
-  case 2:
-      val = (SWITCH_INPUT_3 & (1<<SWITCH_ROW3_PIN) ) == 0;
-      break;
-  }
-  
-  return val;
-}
-//-----------------------------------------------------------
-
@@ -33,6 +33,7 @@
 
 #define COL_PORT		PORTD
 #define COL_DDR			DDRD
+#define COL_MASK		((1<<COL1_PIN) | (1<<COL2_PIN) | (1<<COL3_PIN) | (1<<COL4_PIN))
 
 #define SWITCH_ROW1_PIN		PB2
 #define SWITCH_ROW2_PIN		PB4
@@ -59,20 +60,50 @@
 #define LED_PORT_46		PORTD
 #define LED_DDR_46		DDRD
 
+// LED refresh (timer 1 compare B interrupt)
+#define LED_SLOT_TICKS		375	// 150us per sub slot [timer 1 ticks]
+#define LED_LEVEL_MAX		3	// brightness levels 0..3 = sub slots per LED
+#define LED_LEVEL_PLAYING	LED_LEVEL_MAX
+#define LED_LEVEL_ACTIVE	LED_LEVEL_MAX
+#define LED_LEVEL_NEAREST	1	// active steps in QUANT_MODE_NEAREST
+
+// buttons, scanned by the LED refresh ISR: one column per LED, 4 * 3 * 150us = 1.8ms per scan
+#define KEY_ALL			0xfff
+#define KEY_SCAN_TICKS		(LED_SLOT_TICKS*LED_LEVEL_MAX*4)
+#define KEY_LONG_MS		1000
+#define KEY_LONG_SCANS		(KEY_LONG_MS*2500UL/KEY_SCAN_TICKS)	// 2500 timer 1 ticks per ms
+
+// quantizer modes, a long press on a single button switches between them
+#define QUANT_MODE_UP		0	// next active step at or above the input
+#define QUANT_MODE_NEAREST	1	// closest active step above or below
+
 //-----------------------------------------------------------
 void io_init();
-//one circle trough the whole LED matrix
-void io_processLed();
+//handle the debounced button events, main loop
+void io_processButtonEvents();
+
+/* debounced button events, bit = button nr
+ * each returns the events of the buttons in mask and clears them
+ */
+uint16_t io_getKeyPress(uint16_t mask);
+uint16_t io_getKeyRelease(uint16_t mask);
+//held for KEY_LONG_MS without any other button change, once per press
+uint16_t io_getKeyLong(uint16_t mask);
+uint16_t io_getKeyState();
 
-void io_processLedPipelined();
-//scan all buttons
-void io_processButtons();
-void io_processButtonsPipelined();
+//the SPI port needs the matrix pins, the scan pauses until io_unlockMatrix()
+void io_lockMatrix();
+void io_unlockMatrix();
 
 uint16_t io_getActiveSteps();
 void io_setActiveSteps(uint16_t val);
+//distance from note [0:11] up to the next active step, may wrap into the next octave
+uint8_t io_getStepOffset(uint8_t note);
+//distance from note [0:11] down to the previous active step, may wrap into the octave below
+uint8_t io_getStepOffsetDown(uint8_t note);
+uint8_t io_getQuantMode();
+void io_setQuantMode(uint8_t mode);
 void io_setCurrentQuantizedValue(uint8_t value);
-uint8_t io_isButtonPushed(uint8_t buttonNr);
 
 
 #endif /* IOMATRIX_H_ */
\ No newline at end of file
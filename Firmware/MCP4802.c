@@ -1,10 +1,10 @@
 /*
  * MCP4802.c
  *
- * Driver works for MCP4801 
- * the prototype used a 4802, but channel 2 is not implemented yet 
- * since the final hardware version never used it and a 4801 was used instead
- * needs minor mods for propper 2 channel output
+ * Driver works for MCP4801 and MCP4802
+ * the prototype used a 4802, the final hardware version a 4801.
+ * Both channels are written on every update, a 4801 ignores the channel B words
+ * (bit 15 set = ignore command)
  * 
  * 
  *  Copyright 2015 Julian Schmidt, Sonic Potions <julian@sonic-potions.com>
@@ -29,6 +29,7 @@
 #include "MCP4802.h"
 #include "spi.h"
 #include "IoMatrix.h"
+#include <avr/interrupt.h>
 
 #define DAC_A				0
 #define DAC_B				1
@@ -38,6 +39,17 @@
 
 #define CHANNEL_ACTIVE			1
 #define CHANNEL_SHUTDOWN		0
+
+//transfer engine state
+#define MCP_PENDING			0x01	//mailbox holds words not sent yet
+#define MCP_BUSY			0x02	//transfer running, the engine owns the matrix pins
+#define MCP_LATCH			0x04	//pull LDAC low once the mailbox is empty
+
+//one entry mailbox (A and B word), a newer update replaces one that is still pending (latest wins)
+static volatile uint16_t mcp4802_mailbox[2];
+static volatile uint8_t mcp4802_state = 0;
+static uint16_t mcp4802_words[2];		//update on the wire
+static uint8_t mcp4802_word;			//word of mcp4802_words on the wire, 0..1
 //-----------------------------------------------------------
 void mcp4802_init()
 {
@@ -75,30 +87,114 @@ VOUTpin is connected to 500 k???typical)?
 
 bit 11-0 D11:D0:DAC Input Data bits. Bit x is ignored.
 */
-void mcp4802_outputData(const uint8_t out1, const uint8_t out2)
+/* starts a write cmd, the MSB is polled and the transfer ISR fires after the LSB
+ * at SCK = F_CPU/2 a byte takes 16 cycles, less than an interrupt entry and exit,
+ * so there is one interrupt per word instead of one per byte. interrupts are off
+ */
+static inline void sendWord(const uint16_t word)
 {
-	//LDAC HIGH (no dac update, gate low)
-	MCP_CS_PORT |= (1<<MCP_LDAC_PIN);
 	//CS low -> start write cmd
 	MCP_CS_PORT &= ~(1<<MCP_CS_PIN);
+	SPDR = word>>8;
+	loop_until_bit_is_set(SPSR, SPIF);
+	SPDR = word & 0xff;
+}
+//-----------------------------------------------------------
+//takes the mailbox and puts the A word on the wire, interrupts are off
+static void startTransfer()
+{
+	mcp4802_words[0] = mcp4802_mailbox[0];
+	mcp4802_words[1] = mcp4802_mailbox[1];
+	mcp4802_word = 0;
+	mcp4802_state = (mcp4802_state & ~MCP_PENDING) | MCP_BUSY;
 	
-	//data out B (not implemented)
+	sendWord(mcp4802_words[0]);
+}
+//-----------------------------------------------------------
+//posts both words to the mailbox, the transfer runs in the background
+static void postData(const uint8_t out1, const uint8_t out2, const uint8_t latch)
+{
+	const uint16_t dataA = (DAC_A<<15) | (GAIN_X2<<13) | (CHANNEL_ACTIVE<<12) | (out1<<4);
+	const uint16_t dataB = ((uint16_t)DAC_B<<15) | (GAIN_X2<<13) | (CHANNEL_ACTIVE<<12) | (out2<<4);
 	
-	//data for output A
-	uint16_t data = (DAC_A<<15) | (GAIN_X2<<13) | (CHANNEL_ACTIVE<<12) | (out1<<4);
+	const uint8_t sreg = SREG;
+	cli();
+	mcp4802_mailbox[0] = dataA;
+	mcp4802_mailbox[1] = dataB;
+	mcp4802_state |= MCP_PENDING | latch;
+	if(!(mcp4802_state & MCP_BUSY))
+	{
+		//MISO and SS are button rows, the scan pauses until the engine is idle again
+		io_lockMatrix();
+		spi_enable(1);
+		startTransfer();
+	}
+	SREG = sreg;
+}
+//-----------------------------------------------------------
+//end of a word
+ISR(SPI_STC_vect)
+{
+	// CS high (end write, data is latched into the input register)
+	MCP_CS_PORT |= (1<<MCP_CS_PIN);
 	
-	//save COL_PORT
-	uint8_t port = COL_PORT;
-	COL_PORT |= ( (1<<COL1_PIN) | (1<<COL2_PIN) | (1<<COL3_PIN) | (1<<COL4_PIN) );
-	spi_enable(1);
-	SPI_transmit(data>>8);		//transmit MSB
-	SPI_transmit(data&0xff);	//transmit LSB
-	spi_enable(0);
-	COL_PORT = port;
+	if(mcp4802_word == 0)
+	{
+		//B word
+		mcp4802_word = 1;
+		sendWord(mcp4802_words[1]);
+		return;
+	}
 	
-	// CS high (end write)
-	MCP_CS_PORT |= (1<<MCP_CS_PIN);
+	if(mcp4802_state & MCP_PENDING)
+	{
+		//a newer update arrived during the transfer
+		startTransfer();
+		return;
+	}
 	
-	//LDAC low (update dac outputs, gate high)
-	MCP_CS_PORT &= ~(1<<MCP_LDAC_PIN);
+	if(mcp4802_state & MCP_LATCH)
+	{
+		//LDAC low (update dac outputs, gate high)
+		MCP_CS_PORT &= ~(1<<MCP_LDAC_PIN);
+	}
+	mcp4802_state = 0;
+	spi_enable(0);
+	io_unlockMatrix();
+}
+//-----------------------------------------------------------
+void mcp4802_outputData(const uint8_t out1, const uint8_t out2)
+{
+	//LDAC HIGH (no dac update, gate low)
+	MCP_CS_PORT |= (1<<MCP_LDAC_PIN);
+	
+	//LDAC goes low after both words, A and B change at once
+	postData(out1, out2, MCP_LATCH);
+};
+//-----------------------------------------------------------
+void mcp4802_loadData(const uint8_t out1, const uint8_t out2)
+{
+	postData(out1, out2, 0);
 };
+//-----------------------------------------------------------
+void mcp4802_latch()
+{
+	const uint8_t sreg = SREG;
+	cli();
+	if(mcp4802_state & MCP_BUSY)
+	{
+		//the input register is not complete yet, the ISR latches at the end
+		mcp4802_state |= MCP_LATCH;
+	}
+	else
+	{
+		MCP_CS_PORT &= ~(1<<MCP_LDAC_PIN);
+	}
+	SREG = sreg;
+}
+//-----------------------------------------------------------
+uint8_t mcp4802_isLatchPending()
+{
+	return (mcp4802_state & MCP_LATCH) != 0;
+}
+//-----------------------------------------------------------
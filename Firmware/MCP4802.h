@@ -35,8 +35,20 @@ and VOUTB are updated at the same time.
 */
 #define MCP_LDAC_PIN	PB1
 //-----------------------------------------------------------
+/* the transfers are interrupt driven, a write only waits for the first byte (16 cycles),
+ * one that arrives while the previous one is still on the wire replaces the one waiting in the mailbox
+ */
 void mcp4802_init();
+//write both input registers and update the outputs at once (LDAC pulse after the transfer)
 void mcp4802_outputData(const uint8_t out1, const uint8_t out2);
+//write the input registers only, the outputs keep their value until the next LDAC pulse
+void mcp4802_loadData(const uint8_t out1, const uint8_t out2);
+/* input registers -> outputs, deferred to the end of a running transfer
+ * LDAC must be high before, it stays low (gate high) until the gate timer raises it
+ */
+void mcp4802_latch();
+//an LDAC pulse waits for the running transfer
+uint8_t mcp4802_isLatchPending();
 
 
 #endif /* MCP4802_H_ */
\ No newline at end of file
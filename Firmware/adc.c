@@ -23,6 +23,24 @@
 #include "adc.h"
 #include <avr/interrupt.h>  
 
+/* the ADC runs free: 20MHz/128 = 156kHz ADC clock, 13 clocks per conversion
+ * = ~12kHz sample rate. The ISR keeps the last ADC_OVERSAMPLING samples in a
+ * ring buffer together with their running sum.
+ * 16 samples summed up and shifted down by 2 give a 12 bit value, the noise
+ * on the CV input acts as dither. The sum is a moving average over ~1.3ms,
+ * read out (decimated) whenever the main loop needs a value.
+ */
+static volatile uint16_t adc_samples[ADC_OVERSAMPLING];
+static volatile uint16_t adc_sum = 0;		//sum of adc_samples, max 16*1023
+static volatile uint8_t adc_index = 0;		//next sample to replace
+//-----------------------------------------------------------
+ISR(ADC_vect)
+{
+	const uint16_t sample = ADCW;
+	adc_sum = adc_sum - adc_samples[adc_index] + sample;
+	adc_samples[adc_index] = sample;
+	adc_index = (adc_index+1) & (ADC_OVERSAMPLING-1);
+}
 //-----------------------------------------------------------
 void adc_init(void)
 {
@@ -41,21 +59,55 @@ void adc_init(void)
 	while (ADCSRA & (1<<ADSC) ) {}        // wait to finish
 	// read result 
 	result = ADCW;
+	
+	//fill the filter so the first value is valid
+	for(uint8_t i=0;i<ADC_OVERSAMPLING;i++)
+	{
+	  adc_samples[i] = result;
+	}
+	adc_sum = result * ADC_OVERSAMPLING;
+	
+	// free running mode, interrupt on every conversion
+	ADCSRB &= ~((1<<ADTS2) | (1<<ADTS1) | (1<<ADTS0));
+	ADCSRA |= (1<<ADATE) | (1<<ADIE) | (1<<ADIF);
+	ADCSRA |= (1<<ADSC);                  // start the first conversion
+};
+//-----------------------------------------------------------
+uint16_t adc_getValue()
+{
+	//adc_sum is 16 bit and written by the ISR
+	const uint8_t sreg = SREG;
+	cli();
+	const uint16_t sum = adc_sum;
+	SREG = sreg;
+	return sum >> ADC_DECIMATION_SHIFT;
 };
 //-----------------------------------------------------------
 uint16_t adc_read()
 {
-	ADCSRA |= (1<<ADSC);            // single readout
-	while (ADCSRA & (1<<ADSC) ) {}  // wait to finish
-	return ADCW;
+	//latest conversion
+	const uint8_t sreg = SREG;
+	cli();
+	const uint16_t value = adc_samples[(adc_index-1) & (ADC_OVERSAMPLING-1)];
+	SREG = sreg;
+	return value;
 };
 //-----------------------------------------------------------
-uint16_t adc_readAvg( uint8_t channel, uint8_t nsamples )
+uint16_t adc_readAvg( uint8_t nsamples )
 {
-	uint32_t sum = 0;
+	//average of the latest nsamples conversions
+	if(nsamples == 0) return adc_read();
+	if(nsamples > ADC_OVERSAMPLING) nsamples = ADC_OVERSAMPLING;
+	
+	uint16_t sum = 0;
+	const uint8_t sreg = SREG;
+	cli();
+	uint8_t index = adc_index;
 	for (uint8_t i = 0; i < nsamples; ++i ) {
-	sum += adc_read( channel );
+	index = (index-1) & (ADC_OVERSAMPLING-1);
+	sum += adc_samples[index];
 	}
-  	return (uint16_t)( sum / nsamples );
+	SREG = sreg;
+  	return sum / nsamples;
 };
 //-----------------------------------------------------------
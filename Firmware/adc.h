@@ -26,8 +26,16 @@
 
 #include <avr/io.h>
 
+#define ADC_OVERSAMPLING	16	//samples in the filter, power of 2
+#define ADC_DECIMATION_SHIFT	2	//16 10 bit samples -> 12 bit
+
+//start the free running ADC on channel 0
 void adc_init(void);
+//filtered CV input, 12 bit (0..4092)
+uint16_t adc_getValue();
+//latest single conversion, 10 bit
 uint16_t adc_read();
-uint16_t adc_readAvg( uint8_t channel, uint8_t nsamples );
+//average of the latest nsamples (<= ADC_OVERSAMPLING) conversions, 10 bit
+uint16_t adc_readAvg( uint8_t nsamples );
 
 #endif /* ADC_H_ */
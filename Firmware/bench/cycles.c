@@ -0,0 +1,386 @@
+/*
+ * cycles.c
+ *
+ * cycle counts of the firmware hot paths, measured on the real quantizer.elf
+ * running in simavr ('make bench')
+ *
+ *  usage: cycles ELF SYMBOLS [--baseline FILE] [--write-baseline FILE] [--tolerance PERCENT]
+ *
+ * SYMBOLS is the avr-nm listing of ELF. The firmware first runs in continuous
+ * mode while the CV sweeps the whole input range, then the gate input is
+ * plugged in and the trigger fires every 20ms with a CV that alternates between
+ * two notes, so every trigger produces a new DAC value and an LDAC pulse.
+ *
+ * For every function entry the cycles until its return are counted, including
+ * interrupts that hit in between. Trigger latency is counted from the falling
+ * edge on PD7 to the falling edge on LDAC (PB1). With --baseline the program
+ * exits with 1 if any value is larger than the stored one by more than the
+ * tolerance, or if the baseline or one of its values is missing; the
+ * simulation is deterministic, so the default tolerance is small.
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "avr_ioport.h"
+#include "avr_adc.h"
+
+#define F_CPU			20000000UL
+#define TRIGGER_PERIOD		(F_CPU / 50)
+#define CONTINUOUS_CYCLES	(F_CPU / 2)
+#define TRIGGERED_CYCLES	(F_CPU * 2)
+#define MAX_DEPTH		16
+#define MAX_RESULTS		32
+
+#define SPL			0x5d
+#define SPH			0x5e
+
+typedef struct {
+  const char *symbol;
+  const char *name;
+  uint32_t addr;
+  uint32_t calls;
+  uint64_t total;
+  uint64_t max;
+} Function;
+
+typedef struct {
+  uint8_t function;
+  uint64_t start;
+  uint16_t sp;
+} Frame;
+
+typedef struct {
+  char name[48];
+  double value;
+} Result;
+
+static Function functions[] = {
+  {"quantizeValue", "quantizeValue", 0, 0, 0, 0},
+  {"process", "process", 0, 0, 0, 0},
+  {"__vector_5", "ISR(PCINT2_vect)", 0, 0, 0, 0},
+  {"mcp4802_outputData", "mcp4802_outputData", 0, 0, 0, 0},
+  {"io_processButtonEvents", "io_processButtonEvents", 0, 0, 0, 0},
+  {"__vector_12", "ISR(TIMER1_COMPB_vect)", 0, 0, 0, 0},
+  {"__vector_17", "ISR(SPI_STC_vect)", 0, 0, 0, 0},
+};
+#define NUM_FUNCTIONS (sizeof(functions)/sizeof(functions[0]))
+
+static Frame frames[MAX_DEPTH];
+static int depth = 0;
+
+static uint64_t triggerCycle = 0;
+static uint8_t triggerPending = 0;
+static uint32_t latencies = 0;
+static uint64_t latencyTotal = 0;
+static uint64_t latencyMin = (uint64_t)-1;
+static uint64_t latencyMax = 0;
+
+static avr_t *avr;
+
+static Result results[MAX_RESULTS];
+static int numResults = 0;
+//-----------------------------------------------------------
+static int loadSymbols(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if(!f)
+  {
+    printf("   Can't open symbol file '%s'.\n", path);
+    return 0;
+  }
+  char line[256];
+  while(fgets(line, sizeof(line), f))
+  {
+    unsigned int addr;
+    char type;
+    char name[200];
+    if(sscanf(line, "%x %c %199s", &addr, &type, name) != 3) continue;
+    if(type != 'T' && type != 't') continue;
+    for(unsigned int i=0;i<NUM_FUNCTIONS;i++)
+    {
+      if(strcmp(name, functions[i].symbol) == 0) functions[i].addr = addr;
+    }
+  }
+  fclose(f);
+
+  for(unsigned int i=0;i<NUM_FUNCTIONS;i++)
+  {
+    if(!functions[i].addr) printf("   '%s' not found in '%s' (inlined?)\n", functions[i].symbol, path);
+  }
+  return 1;
+}
+//-----------------------------------------------------------
+static uint16_t stackPointer()
+{
+  return avr->data[SPL] | (avr->data[SPH] << 8);
+}
+//-----------------------------------------------------------
+// called after every instruction
+static void trace()
+{
+  const uint16_t sp = stackPointer();
+
+  // ret/reti pops the return address, a tail call returns with its caller
+  while(depth > 0 && sp > frames[depth-1].sp)
+  {
+    depth--;
+    Function *fn = &functions[frames[depth].function];
+    const uint64_t cycles = avr->cycle - frames[depth].start;
+    fn->calls++;
+    fn->total += cycles;
+    if(cycles > fn->max) fn->max = cycles;
+  }
+
+  for(unsigned int i=0;i<NUM_FUNCTIONS;i++)
+  {
+    if(functions[i].addr && avr->pc == functions[i].addr && depth < MAX_DEPTH)
+    {
+      frames[depth].function = i;
+      frames[depth].start = avr->cycle;
+      frames[depth].sp = sp;
+      depth++;
+    }
+  }
+}
+//-----------------------------------------------------------
+static void ldacChanged(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  (void)irq; (void)param;
+  if(value || !triggerPending) return;
+
+  const uint64_t latency = avr->cycle - triggerCycle;
+  triggerPending = 0;
+  latencies++;
+  latencyTotal += latency;
+  if(latency < latencyMin) latencyMin = latency;
+  if(latency > latencyMax) latencyMax = latency;
+}
+//-----------------------------------------------------------
+static void setPin(char port, int pin, int level)
+{
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(port), pin), level);
+}
+//-----------------------------------------------------------
+static void setCv(uint32_t millivolts)
+{
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0), millivolts);
+}
+//-----------------------------------------------------------
+static int run(uint64_t cycles, int triggered)
+{
+  const uint64_t end = avr->cycle + cycles;
+  const uint64_t start = avr->cycle;
+  uint64_t nextTrigger = avr->cycle + TRIGGER_PERIOD;
+  uint8_t note = 0;
+
+  while(avr->cycle < end)
+  {
+    if(triggered)
+    {
+      if(avr->cycle >= nextTrigger)
+      {
+        // alternate between two notes so every trigger changes the output
+        setCv(note ? 2500 : 1250);
+        note = !note;
+        setPin('D', 7, 0);
+        triggerCycle = avr->cycle;
+        triggerPending = 1;
+        nextTrigger += TRIGGER_PERIOD;
+      }
+      else if(avr->cycle >= triggerCycle + F_CPU / 1000)
+      {
+        setPin('D', 7, 1);
+      }
+    }
+    else
+    {
+      setCv((uint32_t)((avr->cycle - start) * 5000 / cycles));
+    }
+
+    const int state = avr_run(avr);
+    if(state == cpu_Done || state == cpu_Crashed)
+    {
+      printf("   AVR stopped (state %d) at pc 0x%04x.\n", state, avr->pc);
+      return 0;
+    }
+    trace();
+  }
+  return 1;
+}
+//-----------------------------------------------------------
+static void addResult(const char *name, const char *metric, double value)
+{
+  if(numResults >= MAX_RESULTS) return;
+  snprintf(results[numResults].name, sizeof(results[numResults].name), "%s/%s", name, metric);
+  results[numResults].value = value;
+  numResults++;
+}
+//-----------------------------------------------------------
+static double findBaseline(const char *path, const char *name, int *found)
+{
+  FILE *f = fopen(path, "r");
+  char line[256];
+  *found = 0;
+  if(!f) return 0;
+  while(fgets(line, sizeof(line), f))
+  {
+    char key[64];
+    double value;
+    if(line[0] == '#') continue;
+    if(sscanf(line, "%63s %lf", key, &value) == 2 && strcmp(key, name) == 0)
+    {
+      *found = 1;
+      fclose(f);
+      return value;
+    }
+  }
+  fclose(f);
+  return 0;
+}
+//-----------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  const char *elfPath = NULL;
+  const char *symbolPath = NULL;
+  const char *baselinePath = NULL;
+  const char *writePath = NULL;
+  double tolerance = 2;
+
+  for(int i=1;i<argc;i++)
+  {
+    if(strcmp(argv[i], "--baseline") == 0 && i+1 < argc) baselinePath = argv[++i];
+    else if(strcmp(argv[i], "--write-baseline") == 0 && i+1 < argc) writePath = argv[++i];
+    else if(strcmp(argv[i], "--tolerance") == 0 && i+1 < argc) tolerance = atof(argv[++i]);
+    else if(!elfPath) elfPath = argv[i];
+    else if(!symbolPath) symbolPath = argv[i];
+    else elfPath = NULL;
+  }
+  if(!elfPath || !symbolPath)
+  {
+    printf("usage: cycles ELF SYMBOLS [--baseline FILE] [--write-baseline FILE] [--tolerance PERCENT]\n");
+    return 1;
+  }
+  if(!loadSymbols(symbolPath)) return 1;
+
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+  if(elf_read_firmware(elfPath, &firmware) != 0)
+  {
+    printf("   Can't load '%s'.\n", elfPath);
+    return 1;
+  }
+  strcpy(firmware.mmcu, "atmega168");
+  firmware.frequency = F_CPU;
+
+  avr = avr_make_mcu_by_name(firmware.mmcu);
+  if(!avr)
+  {
+    printf("   simavr has no atmega168 core.\n");
+    return 1;
+  }
+  avr_init(avr);
+  avr_load_firmware(avr, &firmware);
+  avr->avcc = avr->aref = avr->vcc = 5000;
+
+  // simavr has no pullups: idle levels of the matrix rows, jack switch and trigger
+  setPin('B', 2, 1);
+  setPin('B', 4, 1);
+  setPin('C', 5, 1);
+  setPin('C', 4, 1);
+  setPin('D', 7, 1);
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 1), ldacChanged, NULL);
+
+  if(!run(CONTINUOUS_CYCLES, 0)) return 1;
+  // plug in the gate cable
+  setPin('C', 4, 0);
+  if(!run(TRIGGERED_CYCLES, 1)) return 1;
+
+  for(unsigned int i=0;i<NUM_FUNCTIONS;i++)
+  {
+    const Function *fn = &functions[i];
+    if(!fn->calls) continue;
+    addResult(fn->name, "avg", (double)fn->total / fn->calls);
+    addResult(fn->name, "max", fn->max);
+  }
+  if(latencies)
+  {
+    addResult("trigger_to_ldac", "min", latencyMin);
+    addResult("trigger_to_ldac", "avg", (double)latencyTotal / latencies);
+    addResult("trigger_to_ldac", "max", latencyMax);
+  }
+
+  // a gate without numbers to compare against must not pass
+  int regression = 0;
+  if(baselinePath)
+  {
+    FILE *f = fopen(baselinePath, "r");
+    if(f) fclose(f);
+    else
+    {
+      printf("   No baseline '%s', 'make bench-baseline' measures one.\n", baselinePath);
+      regression = 1;
+    }
+  }
+
+  printf("%-36s %10s %10s %8s\n", "cycles", "value", "baseline", "delta");
+  for(int i=0;i<numResults;i++)
+  {
+    int found = 0;
+    const double base = baselinePath ? findBaseline(baselinePath, results[i].name, &found) : 0;
+    printf("%-36s %10.1f", results[i].name, results[i].value);
+    if(found)
+    {
+      const double delta = base > 0 ? (results[i].value / base - 1) * 100 : 0;
+      const int slower = delta > tolerance;
+      printf(" %10.1f %+7.1f%%%s", base, delta, slower ? "  REGRESSION" : "");
+      regression |= slower;
+    }
+    else if(baselinePath)
+    {
+      printf(" %10s %8s  NOT IN BASELINE", "-", "-");
+      regression = 1;
+    }
+    printf("\n");
+  }
+  for(unsigned int i=0;i<NUM_FUNCTIONS;i++)
+  {
+    printf("%-36s %10u calls\n", functions[i].name, functions[i].calls);
+  }
+  printf("%-36s %10u triggers\n", "trigger_to_ldac", latencies);
+
+  if(writePath)
+  {
+    FILE *out = fopen(writePath, "w");
+    if(!out)
+    {
+      printf("   Can't open file '%s' for writing.\n", writePath);
+      return 1;
+    }
+    fprintf(out, "# firmware cycle counts, atmega168 -Os in simavr\n");
+    fprintf(out, "# name cycles\n");
+    for(int i=0;i<numResults;i++) fprintf(out, "%s %.1f\n", results[i].name, results[i].value);
+    fclose(out);
+  }
+
+  return regression ? 1 : 0;
+}
+//-----------------------------------------------------------
@@ -24,32 +24,125 @@
  */  
 
 #include "eeprom.h"
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+#include <string.h>
 
-#define EEPROM_DATASIZE 2		// 12 notes = 12 bit = 2 bytes
 #define EEPROM_SIZE 512 		// Atmega168 = 512 byte
-#define BUFFER_MASK 0x7f
 
-#define BUFFER_SIZE (EEPROM_SIZE/2/EEPROM_DATASIZE)	// Atmega168 = 128 bytes. 
-							// using 2 bytes for the 12 bit note value results in 128 * 100.000cycles 
-							// => 12.800.000 cycles
-							// thats about 35 years with 1000 saves per day
-							
-//-----------------------------------------------------------
-static uint16_t dataBuffer[BUFFER_SIZE] EEMEM;		// place to store the note data -> 2x128 = 256 bytes
-static uint8_t statusBuffer[BUFFER_SIZE] EEMEM;		// place to keep the status info (next write position) -> 128 bytes
-static uint8_t currentEepromAddress = 0;
+/* the state log fills the whole EEPROM: 32 slots of 16 bytes
+ * the sequence number of each record is chosen so that seq % STATE_SLOTS is its slot.
+ * So within one lap seq[i]-seq[0] == i holds for all slots up to the newest one and for none
+ * behind it, the newest record is found by a binary search (5 steps) instead of a scan.
+ * 32 slots * 100.000 cycles => 3.200.000 writes, about 9 years with 1000 saves per day
+ */
+#define STATE_SLOTS (EEPROM_SIZE/sizeof(StateRecord))
+#define STATE_MAGIC 0xA0
+#define STATE_CRC_SIZE (sizeof(StateRecord)-sizeof(uint16_t))
+
+static StateRecord stateLog[STATE_SLOTS] EEMEM;
+
+/* layout of the first firmware, placed by avr-gcc in reverse order of definition:
+ * uint8_t statusBuffer[128] at 0x000, uint16_t dataBuffer[128] at 0x080
+ * as read back from its shipped quantizer.hex: findCurrentEepromAddr() passes 0x000+addr
+ * to eeprom_read_byte, eeprom_ReadBuffer()/WriteBuffer() pass 0x080+2*addr to the word access.
+ * host/tests/test_eeprom_legacy.c loads images written that way.
+ * the status ring counts up by one per write like the sequence numbers above.
+ * It only lives until the first new record is written. That goes to the first slot behind
+ * the old layout so a power loss during it leaves the old data readable.
+ */
+#define LEGACY_BUFFER_SIZE 128
+#define LEGACY_BUFFER_MASK 0x7f
+#define LEGACY_STATUS ((const uint8_t*)stateLog)
+#define LEGACY_DATA ((const uint16_t*)((const uint8_t*)stateLog + LEGACY_BUFFER_SIZE))
+#define LEGACY_END_SLOT ((LEGACY_BUFFER_SIZE*3)/sizeof(StateRecord))	// 24
+
+static StateRecord state;				//current state, seq is the one of the newest record
+
+/* write queue for one record, drained by the EE_READY interrupt
+ * the CRC is written last, a record only becomes valid when all of it is written.
+ * A power loss in between leaves the previous record current.
+ */
+#ifndef EEPROM_ADDR
+#define EEPROM_ADDR(p) ((uint16_t)(p))	//EEMEM pointers are EEPROM addresses
+#endif
+static StateRecord queueRecord;
+static uint16_t queueAddr;			//EEPROM address of queueRecord
+static volatile uint8_t queueNext = 0;		//next byte to write
+static volatile uint8_t queueCount = 0;		//bytes in the queue, 0 = idle
 
 //-----------------------------------------------------------
-uint8_t findCurrentEepromAddr()
+static uint16_t stateCrc(const StateRecord *record)
+{
+  uint16_t crc = 0xffff;
+  const uint8_t *data = (const uint8_t*)record;
+  for(uint8_t i=0;i<STATE_CRC_SIZE;i++)
+  {
+    crc = _crc16_update(crc, data[i]);
+  }
+  return crc;
+}
+//-----------------------------------------------------------
+//reads slot into record, returns 1 if it holds a valid record
+static uint8_t readSlot(uint8_t slot, StateRecord *record)
+{
+  eeprom_read_block(record, &stateLog[slot], sizeof(StateRecord));
+  return record->version == (STATE_MAGIC | STATE_VERSION)
+      && (record->seq % STATE_SLOTS) == slot
+      && record->crc == stateCrc(record);
+}
+//-----------------------------------------------------------
+static uint16_t readSeq(uint8_t slot)
+{
+  return eeprom_read_word(&stateLog[slot].seq);
+}
+//-----------------------------------------------------------
+//newest valid record into state, returns 0 if there is none
+static uint8_t findCurrentRecord()
+{
+  StateRecord record;
+  
+  //binary search for the last slot written in the same lap as slot 0
+  const uint16_t seq0 = readSeq(0);
+  uint8_t lo = 0;
+  uint8_t hi = STATE_SLOTS-1;
+  while(lo < hi)
+  {
+    const uint8_t mid = (lo+hi+1)/2;
+    if((uint16_t)(readSeq(mid)-seq0) == mid) lo = mid;
+    else hi = mid-1;
+  }
+  if(readSlot(lo, &record))
+  {
+    state = record;
+    return 1;
+  }
+  
+  /* slot 0 was never written (right after the legacy layout) or a write was interrupted
+   * scan all slots for the newest valid record
+   */
+  uint8_t found = 0;
+  for(uint8_t slot=0;slot<STATE_SLOTS;slot++)
+  {
+    if(readSlot(slot, &record) && (!found || (int16_t)(record.seq-state.seq) > 0))
+    {
+      state = record;
+      found = 1;
+    }
+  }
+  return found;
+}
+//-----------------------------------------------------------
+uint8_t findLegacyEepromAddr()
 {
   uint8_t val1, val2, addr1, addr2;
   addr1 = 0x00;
   
-  for(int i=0; i<BUFFER_SIZE; i++)
+  for(int i=0; i<LEGACY_BUFFER_SIZE; i++)
   {
-    addr2 = ((addr1+1)&BUFFER_MASK);
-    val1 = eeprom_read_byte(&statusBuffer[addr1]);
-    val2 = eeprom_read_byte(&statusBuffer[addr2]);
+    addr2 = ((addr1+1)&LEGACY_BUFFER_MASK);
+    val1 = eeprom_read_byte(&LEGACY_STATUS[addr1]);
+    val2 = eeprom_read_byte(&LEGACY_STATUS[addr2]);
     
      if( ((val1+1)&0xff) == val2)
      {
@@ -68,39 +161,119 @@ uint8_t findCurrentEepromAddr()
 //-----------------------------------------------------------
 /*
  * This function is called once after power up.
- * First the current active eeprom address is searched 
- * then it's content is read from the dataBuffer
+ * First the newest state record is searched,
+ * without one the step mask of the old layout is loaded
+ * (an erased EEPROM reads as all steps active there)
  */
 uint16_t eeprom_ReadBuffer()
 {
-  currentEepromAddress = findCurrentEepromAddr();
-  return eeprom_read_word(&dataBuffer[currentEepromAddress])&0xfff;
+  if(!findCurrentRecord())
+  {
+    const uint8_t addr = findLegacyEepromAddr();
+    
+    state = (StateRecord){0};
+    //the next record goes to slot LEGACY_END_SLOT
+    state.seq = LEGACY_END_SLOT-1;
+    state.steps = eeprom_read_word(&LEGACY_DATA[addr])&0xfff;
+    state.version = STATE_MAGIC | STATE_VERSION;
+  }
+  return state.steps;
+}
+//-----------------------------------------------------------
+const StateRecord* eeprom_getState()
+{
+  return &state;
 }
 //-----------------------------------------------------------
-void eeprom_WriteBuffer(uint16_t data)
+//start the next queued byte, EEPE must be clear
+static void writeNext()
 {
-  //check if current value differs from new value
-  uint16_t storedData = eeprom_read_word(&dataBuffer[currentEepromAddress]);
-  if(storedData == data)
+  const uint8_t *data = (const uint8_t*)&queueRecord;
+  while(queueNext < queueCount)
   {
-    //we have nothing to do -> return
+    EEAR = queueAddr + queueNext;
+    const uint8_t val = data[queueNext];
+    queueNext++;
+    
+    //bytes that already hold the value are skipped (saves wear and 3.4ms)
+    EECR |= (1<<EERE);
+    if(EEDR == val) continue;
+    
+    EEDR = val;
+    //EEPE has to follow EEMPE within 4 cycles
+    EECR |= (1<<EEMPE);
+    EECR |= (1<<EEPE);
     return;
   }
   
-  //we need to write a new value
+  //record complete
+  EECR &= ~(1<<EERIE);
+  queueCount = 0;
+}
+//-----------------------------------------------------------
+ISR(EE_READY_vect)
+{
+  writeNext();
+}
+//-----------------------------------------------------------
+uint8_t eeprom_isBusy()
+{
+  return queueCount != 0;
+}
+//-----------------------------------------------------------
+void eeprom_Flush()
+{
+  while(queueCount)
+  {
+    const uint8_t sreg = SREG;
+    cli();
+    if(queueCount && !(EECR & (1<<EEPE)))
+    {
+      writeNext();
+    }
+    SREG = sreg;
+  }
+}
+//-----------------------------------------------------------
+uint8_t eeprom_WriteState(const StateRecord *newState)
+{
+  if(queueCount)
+  {
+    //previous record still being written
+    return 0;
+  }
   
-  //get current stausBuffer value
-  uint8_t status = eeprom_read_byte(&statusBuffer[currentEepromAddress]);
+  //check if the current state differs from the new state
+  StateRecord record = *newState;
+  record.seq = state.seq;
+  record.version = state.version;
+  record.crc = state.crc;
+  if(memcmp(&record, &state, sizeof(StateRecord)) == 0)
+  {
+    //we have nothing to do -> return
+    return 1;
+  }
   
-  // increment current dataBuffer address
-  currentEepromAddress = (currentEepromAddress+1)&BUFFER_MASK;
+  //we need to write a new record to the next slot
+  record.seq = state.seq+1;
+  record.version = STATE_MAGIC | STATE_VERSION;
+  record.crc = stateCrc(&record);
+  state = record;
   
-  // store parameter to dataBuffer
-  eeprom_write_word(&dataBuffer[currentEepromAddress], data);
+  queueRecord = record;
+  queueAddr = EEPROM_ADDR(&stateLog[record.seq % STATE_SLOTS]);
   
-  //increment and store status buffer value
-  status += 1;//(status+1)&BUFFER_MASK;
-   
-  eeprom_write_byte(&statusBuffer[currentEepromAddress],status);
+  //the EE_READY interrupt writes the bytes in the background
+  queueNext = 0;
+  queueCount = sizeof(StateRecord);
+  EECR |= (1<<EERIE);
+  return 1;
+}
+//-----------------------------------------------------------
+uint8_t eeprom_WriteBuffer(uint16_t data)
+{
+  StateRecord newState = state;
+  newState.steps = data;
+  return eeprom_WriteState(&newState);
 }
 //-----------------------------------------------------------
@@ -25,5 +25,38 @@
 #include <avr/io.h>
 #include <avr/eeprom.h>
 
+#define STATE_VERSION 1
+#define STATE_PRESETS 3
+
+/* persistent state, 16 bytes, no padding on the AVR or the host
+ * written as a wear levelled log, see eeprom.c
+ */
+typedef struct
+{
+  uint16_t seq;				//sequence number, seq % STATE_SLOTS is the log slot
+  uint16_t steps;			//active steps, 12 bit
+  uint16_t presets[STATE_PRESETS];	//stored step masks
+  uint8_t version;			//STATE_MAGIC | STATE_VERSION
+  uint8_t mode;				//quantizer mode
+  int8_t calOffset;			//CV input offset trim [12 bit ADC steps]
+  int8_t calGain;			//CV input gain trim [1/1024]
+  uint16_t crc;				//crc16 of the bytes above
+} StateRecord;
+
+/* finds the current state record, falls back to the layout of the first firmware
+ * (12 bit step mask + status ring) and to defaults.
+ * Called once after power up, returns the active steps
+ */
 uint16_t eeprom_ReadBuffer();
-void eeprom_WriteBuffer(uint16_t data);
+//the state loaded by eeprom_ReadBuffer() or last written
+const StateRecord* eeprom_getState();
+/* queues a new record, the bytes are written in the background (EE_READY interrupt)
+ * the header fields (seq, version, crc) of state are ignored
+ * returns 0 if the previous record is still being written, nothing is queued then
+ */
+uint8_t eeprom_WriteState(const StateRecord *state);
+//eeprom_WriteState() with new active steps
+uint8_t eeprom_WriteBuffer(uint16_t data);
+uint8_t eeprom_isBusy();
+//wait until the queued record is written, works with interrupts disabled
+void eeprom_Flush();
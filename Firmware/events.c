@@ -0,0 +1,70 @@
+/*
+ * events.c
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include "events.h"
+#include "timebase.h"
+
+static volatile uint16_t event_queue[EVENT_QUEUE_SIZE];
+static volatile uint8_t event_head = 0;	//next free slot, written by the ISR
+static volatile uint8_t event_tail = 0;	//oldest event, written by the main loop
+static EventStats event_stats;
+//-----------------------------------------------------------
+void event_push(uint16_t stamp)
+{
+  const uint8_t head = event_head;
+  const uint8_t depth = (uint8_t)(head - event_tail);
+  if(depth >= EVENT_QUEUE_SIZE)
+  {
+    //full, keep the older events
+    if(event_stats.overflows < 0xff) event_stats.overflows++;
+    return;
+  }
+  
+  event_queue[head & EVENT_QUEUE_MASK] = stamp;
+  //publish after the slot is written
+  event_head = head+1;
+  
+  if(depth+1 > event_stats.maxDepth) event_stats.maxDepth = depth+1;
+}
+//-----------------------------------------------------------
+uint8_t event_pop(uint16_t *stamp)
+{
+  const uint8_t tail = event_tail;
+  if(tail == event_head) return 0;
+  
+  *stamp = event_queue[tail & EVENT_QUEUE_MASK];
+  //free the slot after it is read
+  event_tail = tail+1;
+  
+  const uint16_t latency = timer_elapsed(*stamp);
+  if(latency > event_stats.maxLatency) event_stats.maxLatency = latency;
+  event_stats.serviced++;
+  return 1;
+}
+//-----------------------------------------------------------
+uint8_t event_getDepth()
+{
+  return (uint8_t)(event_head - event_tail);
+}
+//-----------------------------------------------------------
+const EventStats* event_getStats()
+{
+  return &event_stats;
+}
+//-----------------------------------------------------------
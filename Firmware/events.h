@@ -0,0 +1,55 @@
+/*
+ * events.h
+ *
+ * trigger events from the pin change ISR to the main loop
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+#include <avr/io.h>
+
+/* single producer (ISR) / single consumer (main loop) ring buffer
+ * head is only written by the producer, tail only by the consumer.
+ * Both are 8 bit, reading and writing them is atomic on the AVR so no
+ * interrupt locking is needed.
+ */
+#define EVENT_QUEUE_SIZE 8 // power of 2
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_SIZE-1)
+
+typedef struct
+{
+  uint8_t maxDepth;	//most events waiting at once
+  uint8_t overflows;	//events dropped because the queue was full (saturates)
+  uint16_t maxLatency;	//worst case enqueue -> service [timer ticks]
+  uint16_t serviced;	//events taken from the queue (wraps)
+} EventStats;
+
+//-----------------------------------------------------------
+//producer, ISR only. stamp = timer_now() at the edge
+void event_push(uint16_t stamp);
+/* consumer, main loop only
+ * returns 1 and the timestamp of the oldest event, 0 if the queue is empty
+ * the service latency is measured when the event is taken
+ */
+uint8_t event_pop(uint16_t *stamp);
+uint8_t event_getDepth();
+const EventStats* event_getStats();
+
+#endif /* EVENTS_H_ */
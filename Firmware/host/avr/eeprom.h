@@ -0,0 +1,52 @@
+/*
+ * avr/eeprom.h (host build)
+ *
+ * EEMEM variables only reserve addresses, the contents live in avr_sim.c
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_AVR_EEPROM_H_
+#define HOST_AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EEMEM			__attribute__((section("sim_eeprom")))
+
+// EEPROM address of an EEMEM variable for EEAR, on the AVR the pointer is the address
+uint16_t sim_eepromAddr(const void *p);
+#define EEPROM_ADDR(p)		sim_eepromAddr(p)
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+uint16_t eeprom_read_word(const uint16_t *addr);
+uint32_t eeprom_read_dword(const uint32_t *addr);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+
+//writes block for the duration of the previous write, like avr-libc
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_write_word(uint16_t *addr, uint16_t value);
+void eeprom_write_dword(uint32_t *addr, uint32_t value);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+void eeprom_update_word(uint16_t *addr, uint16_t value);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+uint8_t eeprom_is_ready(void);
+#define eeprom_busy_wait()	do { } while (!eeprom_is_ready())
+
+#endif /* HOST_AVR_EEPROM_H_ */
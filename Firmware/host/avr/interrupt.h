@@ -0,0 +1,37 @@
+/*
+ * avr/interrupt.h (host build)
+ *
+ * ISR() defines a plain function, avr_sim.c calls it when the interrupt fires
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+void sim_sei(void);
+void sim_cli(void);
+
+#define sei()			sim_sei()
+#define cli()			sim_cli()
+#define reti()			return
+
+#define ISR(vector, ...)	void vector(void); void vector(void)
+#define EMPTY_INTERRUPT(vector)	void vector(void); void vector(void) {}
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
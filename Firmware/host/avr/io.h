@@ -0,0 +1,353 @@
+/*
+ * avr/io.h (host build)
+ *
+ * atmega168 register file for the host build. Every register access goes
+ * through sim_reg8()/sim_reg16() so the simulated peripherals in avr_sim.c
+ * can follow what the firmware does.
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+volatile uint8_t *sim_reg8(uint8_t addr);
+volatile uint16_t *sim_reg16(uint8_t addr);
+
+#define _SFR_MEM8(addr)		(*sim_reg8(addr))
+#define _SFR_MEM16(addr)	(*sim_reg16(addr))
+#define _BV(bit)		(1 << (bit))
+
+#define bit_is_set(sfr, bit)	((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit)	(!((sfr) & _BV(bit)))
+#define loop_until_bit_is_set(sfr, bit)		do { } while (bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit)	do { } while (bit_is_set(sfr, bit))
+
+#define RAMEND			0x4FF
+#define E2END			0x1FF
+#define FLASHEND		0x3FFF
+#define SPM_PAGESIZE		128
+
+// ---------- Ports ----------
+#define PINB			_SFR_MEM8(0x23)
+#define DDRB			_SFR_MEM8(0x24)
+#define PORTB			_SFR_MEM8(0x25)
+#define PINC			_SFR_MEM8(0x26)
+#define DDRC			_SFR_MEM8(0x27)
+#define PORTC			_SFR_MEM8(0x28)
+#define PIND			_SFR_MEM8(0x29)
+#define DDRD			_SFR_MEM8(0x2A)
+#define PORTD			_SFR_MEM8(0x2B)
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+// ---------- Interrupt flags and masks ----------
+#define TIFR0			_SFR_MEM8(0x35)
+#define TOV0 0
+#define OCF0A 1
+#define OCF0B 2
+
+#define TIFR1			_SFR_MEM8(0x36)
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define ICF1 5
+
+#define TIFR2			_SFR_MEM8(0x37)
+#define TOV2 0
+#define OCF2A 1
+#define OCF2B 2
+
+#define PCIFR			_SFR_MEM8(0x3B)
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+
+#define EIFR			_SFR_MEM8(0x3C)
+#define EIMSK			_SFR_MEM8(0x3D)
+#define GPIOR0			_SFR_MEM8(0x3E)
+#define GPIOR1			_SFR_MEM8(0x4A)
+#define GPIOR2			_SFR_MEM8(0x4B)
+
+// ---------- EEPROM ----------
+#define EECR			_SFR_MEM8(0x3F)
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+#define EEPM0 4
+#define EEPM1 5
+
+#define EEDR			_SFR_MEM8(0x40)
+#define EEAR			_SFR_MEM16(0x41)
+#define EEARL			_SFR_MEM8(0x41)
+#define EEARH			_SFR_MEM8(0x42)
+
+// ---------- Timer 0 ----------
+#define GTCCR			_SFR_MEM8(0x43)
+#define TCCR0A			_SFR_MEM8(0x44)
+#define WGM00 0
+#define WGM01 1
+#define COM0B0 4
+#define COM0B1 5
+#define COM0A0 6
+#define COM0A1 7
+
+#define TCCR0B			_SFR_MEM8(0x45)
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define WGM02 3
+#define FOC0B 6
+#define FOC0A 7
+
+#define TCNT0			_SFR_MEM8(0x46)
+#define OCR0A			_SFR_MEM8(0x47)
+#define OCR0B			_SFR_MEM8(0x48)
+
+// ---------- SPI ----------
+#define SPCR			_SFR_MEM8(0x4C)
+#define SPR0 0
+#define SPR1 1
+#define CPHA 2
+#define CPOL 3
+#define MSTR 4
+#define DORD 5
+#define SPE 6
+#define SPIE 7
+
+#define SPSR			_SFR_MEM8(0x4D)
+#define SPI2X 0
+#define WCOL 6
+#define SPIF 7
+
+#define SPDR			_SFR_MEM8(0x4E)
+
+// ---------- Analog comparator ----------
+#define ACSR			_SFR_MEM8(0x50)
+#define ACIS0 0
+#define ACIS1 1
+#define ACIC 2
+#define ACIE 3
+#define ACI 4
+#define ACO 5
+#define ACBG 6
+#define ACD 7
+
+// ---------- System ----------
+#define SMCR			_SFR_MEM8(0x53)
+#define MCUSR			_SFR_MEM8(0x54)
+#define MCUCR			_SFR_MEM8(0x55)
+#define SREG			_SFR_MEM8(0x5F)
+#define SREG_I 7
+#define WDTCSR			_SFR_MEM8(0x60)
+#define CLKPR			_SFR_MEM8(0x61)
+#define PRR			_SFR_MEM8(0x64)
+
+// ---------- Pin change interrupts ----------
+#define PCICR			_SFR_MEM8(0x68)
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+
+#define EICRA			_SFR_MEM8(0x69)
+#define PCMSK0			_SFR_MEM8(0x6B)
+#define PCMSK1			_SFR_MEM8(0x6C)
+#define PCMSK2			_SFR_MEM8(0x6D)
+
+#define PCINT0 0
+#define PCINT1 1
+#define PCINT2 2
+#define PCINT3 3
+#define PCINT4 4
+#define PCINT5 5
+#define PCINT6 6
+#define PCINT7 7
+#define PCINT8 0
+#define PCINT9 1
+#define PCINT10 2
+#define PCINT11 3
+#define PCINT12 4
+#define PCINT13 5
+#define PCINT14 6
+#define PCINT16 0
+#define PCINT17 1
+#define PCINT18 2
+#define PCINT19 3
+#define PCINT20 4
+#define PCINT21 5
+#define PCINT22 6
+#define PCINT23 7
+
+#define TIMSK0			_SFR_MEM8(0x6E)
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+
+#define TIMSK1			_SFR_MEM8(0x6F)
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define ICIE1 5
+
+#define TIMSK2			_SFR_MEM8(0x70)
+#define TOIE2 0
+#define OCIE2A 1
+#define OCIE2B 2
+
+// ---------- ADC ----------
+#define ADCW			_SFR_MEM16(0x78)
+#define ADC			_SFR_MEM16(0x78)
+#define ADCL			_SFR_MEM8(0x78)
+#define ADCH			_SFR_MEM8(0x79)
+
+#define ADCSRA			_SFR_MEM8(0x7A)
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADATE 5
+#define ADSC 6
+#define ADEN 7
+
+#define ADCSRB			_SFR_MEM8(0x7B)
+#define ADTS0 0
+#define ADTS1 1
+#define ADTS2 2
+#define ACME 6
+
+#define ADMUX			_SFR_MEM8(0x7C)
+#define MUX0 0
+#define MUX1 1
+#define MUX2 2
+#define MUX3 3
+#define ADLAR 5
+#define REFS0 6
+#define REFS1 7
+
+#define DIDR0			_SFR_MEM8(0x7E)
+#define ADC0D 0
+#define ADC1D 1
+#define ADC2D 2
+#define ADC3D 3
+#define ADC4D 4
+#define ADC5D 5
+
+#define DIDR1			_SFR_MEM8(0x7F)
+
+// ---------- Timer 1 ----------
+#define TCCR1A			_SFR_MEM8(0x80)
+#define WGM10 0
+#define WGM11 1
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+
+#define TCCR1B			_SFR_MEM8(0x81)
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define ICES1 6
+#define ICNC1 7
+
+#define TCCR1C			_SFR_MEM8(0x82)
+#define TCNT1			_SFR_MEM16(0x84)
+#define ICR1			_SFR_MEM16(0x86)
+#define OCR1A			_SFR_MEM16(0x88)
+#define OCR1B			_SFR_MEM16(0x8A)
+
+// ---------- Timer 2 ----------
+#define TCCR2A			_SFR_MEM8(0xB0)
+#define WGM20 0
+#define WGM21 1
+#define COM2B0 4
+#define COM2B1 5
+#define COM2A0 6
+#define COM2A1 7
+
+#define TCCR2B			_SFR_MEM8(0xB1)
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define WGM22 3
+
+#define TCNT2			_SFR_MEM8(0xB2)
+#define OCR2A			_SFR_MEM8(0xB3)
+#define OCR2B			_SFR_MEM8(0xB4)
+#define ASSR			_SFR_MEM8(0xB6)
+
+// ---------- Interrupt vectors ----------
+#define _VECTOR(N)		__vector_ ## N
+
+#define INT0_vect		_VECTOR(1)
+#define INT1_vect		_VECTOR(2)
+#define PCINT0_vect		_VECTOR(3)
+#define PCINT1_vect		_VECTOR(4)
+#define PCINT2_vect		_VECTOR(5)
+#define WDT_vect		_VECTOR(6)
+#define TIMER2_COMPA_vect	_VECTOR(7)
+#define TIMER2_COMPB_vect	_VECTOR(8)
+#define TIMER2_OVF_vect		_VECTOR(9)
+#define TIMER1_CAPT_vect	_VECTOR(10)
+#define TIMER1_COMPA_vect	_VECTOR(11)
+#define TIMER1_COMPB_vect	_VECTOR(12)
+#define TIMER1_OVF_vect		_VECTOR(13)
+#define TIMER0_COMPA_vect	_VECTOR(14)
+#define TIMER0_COMPB_vect	_VECTOR(15)
+#define TIMER0_OVF_vect		_VECTOR(16)
+#define SPI_STC_vect		_VECTOR(17)
+#define USART_RX_vect		_VECTOR(18)
+#define USART_UDRE_vect		_VECTOR(19)
+#define USART_TX_vect		_VECTOR(20)
+#define ADC_vect		_VECTOR(21)
+#define EE_READY_vect		_VECTOR(22)
+#define ANALOG_COMP_vect	_VECTOR(23)
+#define TWI_vect		_VECTOR(24)
+#define SPM_READY_vect		_VECTOR(25)
+
+#define _VECTORS_SIZE		26
+
+#endif /* HOST_AVR_IO_H_ */
@@ -0,0 +1,38 @@
+/*
+ * avr/pgmspace.h (host build)
+ *
+ * flash and RAM share one address space on the host
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)			(s)
+
+#define pgm_read_byte(addr)	(*(const uint8_t *)(addr))
+#define pgm_read_word(addr)	(*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)	(*(const uint32_t *)(addr))
+
+#define memcpy_P		memcpy
+#define strlen_P		strlen
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,890 @@
+/*
+ * avr_sim.c
+ *
+ * functional model of the atmega168 peripherals used by the firmware
+ * plus the Penrose board around it (button matrix, LEDs, MCP4802, jacks)
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "avr_sim.h"
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "IoMatrix.h"
+#include "MCP4802.h"
+
+#define TRIGGER_PIN		PD7
+#define JACK_SWITCH_PIN		PC4
+
+#define PORT_B			0
+#define PORT_C			1
+#define PORT_D			2
+#define NUM_PORTS		3
+
+/* The firmware writes straight into io[]. Writes are detected on the next
+ * register access by comparing io[] against shadow[], the state the simulation
+ * last left the registers in. A write that does not change a register is
+ * therefore invisible, which only matters for write-one-to-clear flags.
+ */
+static volatile uint8_t io[0x100];
+static uint8_t shadow[0x100];
+
+static uint64_t cycles;
+static uint64_t stopAt;
+static uint8_t running;
+static jmp_buf runJump;
+
+static void (*hook)(void);
+static uint32_t hookPeriod;
+static uint64_t nextHook;
+static uint8_t inHook;
+static void (*isrHook)(uint8_t vector, uint8_t enter);
+
+static uint8_t extLevel[NUM_PORTS];
+static uint8_t extDriven[NUM_PORTS];
+static uint8_t pinState[NUM_PORTS];
+static uint16_t buttons;
+
+static uint16_t adcInput[8];
+static int32_t adcRemaining;	// cycles until the running conversion completes, 0 = idle
+static uint8_t adcFirst;
+
+static int32_t spiRemaining;
+static uint8_t spiData;
+
+static uint8_t eeprom[E2END+1];
+static int32_t eepromRemaining;
+
+static uint32_t timerPrescaler[3];
+
+static uint32_t dacShift;
+static uint8_t dacBits;
+static uint8_t dacInput[2];
+static uint8_t dacOutput[2];
+static uint32_t dacUpdates;
+static void (*dacHook)(uint8_t channel, uint8_t value);
+
+static uint32_t litLeds;	// bit led*2+colour
+static uint64_t litSince;
+static uint64_t ledCycles[24];
+
+extern char __start_sim_eeprom[] __attribute__((weak));
+
+// ISR()s are only linked in if the firmware defines them
+#define WEAK_VECTOR(n) extern void __vector_ ## n(void) __attribute__((weak));
+WEAK_VECTOR(1) WEAK_VECTOR(2) WEAK_VECTOR(3) WEAK_VECTOR(4) WEAK_VECTOR(5)
+WEAK_VECTOR(6) WEAK_VECTOR(7) WEAK_VECTOR(8) WEAK_VECTOR(9) WEAK_VECTOR(10)
+WEAK_VECTOR(11) WEAK_VECTOR(12) WEAK_VECTOR(13) WEAK_VECTOR(14) WEAK_VECTOR(15)
+WEAK_VECTOR(16) WEAK_VECTOR(17) WEAK_VECTOR(18) WEAK_VECTOR(19) WEAK_VECTOR(20)
+WEAK_VECTOR(21) WEAK_VECTOR(22) WEAK_VECTOR(23) WEAK_VECTOR(24) WEAK_VECTOR(25)
+
+static void (* const vectors[_VECTORS_SIZE])(void) = {
+  NULL, __vector_1, __vector_2, __vector_3, __vector_4, __vector_5,
+  __vector_6, __vector_7, __vector_8, __vector_9, __vector_10,
+  __vector_11, __vector_12, __vector_13, __vector_14, __vector_15,
+  __vector_16, __vector_17, __vector_18, __vector_19, __vector_20,
+  __vector_21, __vector_22, __vector_23, __vector_24, __vector_25,
+};
+
+//charlieplex pins of each LED, see IoMatrix.c. pin 0-2 = PC1-PC3, pin 3-5 = PD4-PD6
+static const uint8_t ledPins[12][2] = {
+  {0,1},{0,2},{0,3},{1,2},{1,3},{1,4},{2,3},{2,4},{2,5},{3,4},{3,5},{4,5}
+};
+
+static void advance(uint32_t n);
+static void dispatch(void);
+//-----------------------------------------------------------
+static void fatal(const char *msg, int value)
+{
+  fprintf(stderr, "sim: %s (%d) at cycle %llu\n", msg, value, (unsigned long long)cycles);
+  exit(1);
+}
+//-----------------------------------------------------------
+void sim_init(void)
+{
+  memset((void*)io, 0, sizeof(io));
+  memset(shadow, 0, sizeof(shadow));
+  memset(eeprom, 0xff, sizeof(eeprom));
+  memset(extDriven, 0, sizeof(extDriven));
+  memset(extLevel, 0, sizeof(extLevel));
+  memset(pinState, 0, sizeof(pinState));
+  memset(adcInput, 0, sizeof(adcInput));
+  memset(timerPrescaler, 0, sizeof(timerPrescaler));
+  memset(ledCycles, 0, sizeof(ledCycles));
+  memset(dacInput, 0, sizeof(dacInput));
+  memset(dacOutput, 0, sizeof(dacOutput));
+  cycles = 0;
+  stopAt = 0;
+  nextHook = hookPeriod;
+  buttons = 0;
+  adcRemaining = 0;
+  adcFirst = 1;
+  spiRemaining = 0;
+  eepromRemaining = 0;
+  dacShift = 0;
+  dacBits = 0;
+  dacUpdates = 0;
+  litLeds = 0;
+  litSince = 0;
+
+  // nothing plugged in: the trigger input stage idles high
+  extDriven[PORT_D] = 1<<TRIGGER_PIN;
+  extLevel[PORT_D] = 1<<TRIGGER_PIN;
+}
+//-----------------------------------------------------------
+uint64_t sim_getCycles(void)
+{
+  return cycles;
+}
+//-----------------------------------------------------------
+double sim_getSeconds(void)
+{
+  return (double)cycles / F_CPU;
+}
+//-----------------------------------------------------------
+void sim_run(int (*entry)(void), uint64_t maxCycles)
+{
+  stopAt = maxCycles ? cycles + maxCycles : 0;
+  if(setjmp(runJump) == 0)
+  {
+    running = 1;
+    entry();
+  }
+  running = 0;
+  inHook = 0;
+}
+//-----------------------------------------------------------
+void sim_stop(void)
+{
+  if(running) longjmp(runJump, 1);
+}
+//-----------------------------------------------------------
+void sim_setHook(void (*h)(void), uint32_t periodCycles)
+{
+  hook = h;
+  hookPeriod = periodCycles;
+  nextHook = cycles + periodCycles;
+}
+//-----------------------------------------------------------
+void sim_setIsrHook(void (*h)(uint8_t vector, uint8_t enter))
+{
+  isrHook = h;
+}
+//-----------------------------------------------------------
+// pins
+//-----------------------------------------------------------
+static uint8_t computePins(uint8_t port)
+{
+  const uint8_t ddr = io[0x24 + 3*port];
+  const uint8_t out = io[0x25 + 3*port];
+  // undriven inputs read their pullup, a floating pin reads low
+  uint8_t in = (extDriven[port] & extLevel[port]) | (~extDriven[port] & out);
+
+  // a pressed button connects its row to its column, columns are driven low one at a time
+  for(uint8_t i=0;i<12;i++)
+  {
+    if(!(buttons & (1<<i))) continue;
+    const uint8_t col = i%4;
+    const uint8_t colLow = (io[0x2A] & (1<<col)) && !(io[0x2B] & (1<<col));
+    if(!colLow) continue;
+    switch(i/4)
+    {
+      case 0: if(port == PORT_B) in &= ~(1<<SWITCH_ROW1_PIN); break;
+      case 1: if(port == PORT_B) in &= ~(1<<SWITCH_ROW2_PIN); break;
+      case 2: if(port == PORT_C) in &= ~(1<<SWITCH_ROW3_PIN); break;
+    }
+  }
+  return (ddr & out) | (~ddr & in);
+}
+//-----------------------------------------------------------
+static void accountLeds(void)
+{
+  for(uint8_t i=0;i<24;i++)
+  {
+    if(litLeds & (1UL << i)) ledCycles[i] += cycles - litSince;
+  }
+  litSince = cycles;
+}
+//-----------------------------------------------------------
+static void updateLeds(void)
+{
+  uint8_t high = 0, low = 0;
+  for(uint8_t p=0;p<6;p++)
+  {
+    const uint8_t port = p < 3 ? PORT_C : PORT_D;
+    const uint8_t bit = p < 3 ? LED_1_PIN + p : LED_4_PIN + p - 3;
+    if(!(io[0x24 + 3*port] & (1<<bit))) continue;
+    if(io[0x25 + 3*port] & (1<<bit)) high |= 1<<p;
+    else low |= 1<<p;
+  }
+  accountLeds();
+  litLeds = 0;
+  for(uint8_t i=0;i<12;i++)
+  {
+    const uint8_t a = 1<<ledPins[i][0];
+    const uint8_t b = 1<<ledPins[i][1];
+    if((high & a) && (low & b)) litLeds |= 1UL << (i*2);
+    if((low & a) && (high & b)) litLeds |= 1UL << (i*2+1);
+  }
+}
+//-----------------------------------------------------------
+static void updatePins(void)
+{
+  for(uint8_t port=0;port<NUM_PORTS;port++)
+  {
+    const uint8_t pins = computePins(port);
+    const uint8_t changed = pins ^ pinState[port];
+    pinState[port] = pins;
+    io[0x23 + 3*port] = shadow[0x23 + 3*port] = pins;
+
+    // PCINT0-7 = PB0-7, PCINT8-14 = PC0-6, PCINT16-23 = PD0-7
+    if(changed & io[0x6B + port]) io[0x3B] = shadow[0x3B] |= 1<<port;
+  }
+
+  // SS low while configured as input drops the SPI out of master mode
+  if((io[0x4C] & (1<<SPE)) && (io[0x4C] & (1<<MSTR)) && !(io[0x24] & (1<<PB2)) && !(pinState[PORT_B] & (1<<PB2)))
+  {
+    io[0x4C] = shadow[0x4C] &= ~(1<<MSTR);
+    io[0x4D] = shadow[0x4D] |= 1<<SPIF;
+  }
+  updateLeds();
+}
+//-----------------------------------------------------------
+void sim_setPin(char port, uint8_t pin, uint8_t level)
+{
+  const uint8_t p = port - 'B';
+  extDriven[p] |= 1<<pin;
+  if(level) extLevel[p] |= 1<<pin;
+  else extLevel[p] &= ~(1<<pin);
+  updatePins();
+}
+//-----------------------------------------------------------
+void sim_releasePin(char port, uint8_t pin)
+{
+  extDriven[port - 'B'] &= ~(1<<pin);
+  updatePins();
+}
+//-----------------------------------------------------------
+// MCP4802
+//-----------------------------------------------------------
+static void dacUpdate(uint8_t channel)
+{
+  dacOutput[channel] = dacInput[channel];
+  dacUpdates++;
+  if(dacHook) dacHook(channel, dacOutput[channel]);
+}
+//-----------------------------------------------------------
+static void portBChanged(uint8_t old, uint8_t now)
+{
+  const uint8_t cs = 1<<MCP_CS_PIN;
+  const uint8_t ldac = 1<<MCP_LDAC_PIN;
+
+  if((old & cs) && !(now & cs))
+  {
+    dacBits = 0;
+  }
+  if(!(old & cs) && (now & cs) && dacBits >= 16)
+  {
+    // A/B, -, GA, SHDN, D7..D0, 4 ignored bits
+    const uint16_t word = dacShift & 0xffff;
+    const uint8_t channel = word >> 15;
+    dacInput[channel] = (word >> 4) & 0xff;
+    if(!(now & ldac)) dacUpdate(channel);
+  }
+  if((old & ldac) && !(now & ldac))
+  {
+    dacUpdate(0);
+    dacUpdate(1);
+  }
+}
+//-----------------------------------------------------------
+// register writes
+//-----------------------------------------------------------
+static uint8_t changed(uint8_t addr)
+{
+  return io[addr] != shadow[addr];
+}
+//-----------------------------------------------------------
+// write-one-to-clear flag register
+static void clearFlags(uint8_t addr, uint8_t mask)
+{
+  if(!changed(addr)) return;
+  io[addr] = shadow[addr] & ~(io[addr] & mask);
+}
+//-----------------------------------------------------------
+static uint32_t spiClockDivider(void)
+{
+  static const uint8_t dividers[4] = {4, 16, 64, 128};
+  uint32_t div = dividers[io[0x4C] & 3];
+  if(io[0x4D] & (1<<SPI2X)) div /= 2;
+  return div;
+}
+//-----------------------------------------------------------
+static void sync(void)
+{
+  uint8_t pinsDirty = 0;
+
+  if(memcmp(shadow, (const void*)io, sizeof(shadow)) == 0) return;
+
+  // writing a one to PINx toggles the PORTx bit
+  for(uint8_t port=0;port<NUM_PORTS;port++)
+  {
+    const uint8_t pin = 0x23 + 3*port;
+    if(changed(pin))
+    {
+      io[pin+2] ^= io[pin];
+      io[pin] = shadow[pin];
+    }
+  }
+  for(uint8_t addr=0x24;addr<=0x2B;addr++)
+  {
+    if(changed(addr)) pinsDirty = 1;
+  }
+  if(changed(0x25)) portBChanged(shadow[0x25], io[0x25]);
+
+  clearFlags(0x35, 0x07);	// TIFR0
+  clearFlags(0x36, 0x27);	// TIFR1
+  clearFlags(0x37, 0x07);	// TIFR2
+  clearFlags(0x3B, 0x07);	// PCIFR
+
+  // SPI: SPIF is read only, a changed SPDR starts a transfer
+  if(changed(0x4D))
+  {
+    io[0x4D] = (shadow[0x4D] & ~(1<<SPI2X)) | (io[0x4D] & (1<<SPI2X));
+  }
+  if(changed(0x4E) && (io[0x4C] & (1<<SPE)))
+  {
+    if(spiRemaining > 0)
+    {
+      io[0x4D] |= 1<<WCOL;
+    }
+    else if(io[0x4C] & (1<<MSTR))
+    {
+      spiData = io[0x4E];
+      spiRemaining = 8 * spiClockDivider();
+      io[0x4D] &= ~(1<<SPIF);
+    }
+  }
+  if(changed(0x4C)) pinsDirty = 1;
+
+  // ADC: ADIF is cleared by writing a one, ADSC starts a conversion
+  if(changed(0x7A))
+  {
+    uint8_t val = io[0x7A];
+    uint8_t flag = (shadow[0x7A] & (1<<ADIF)) && !(val & (1<<ADIF));
+    val = (val & ~(1<<ADIF)) | (flag ? (1<<ADIF) : 0);
+    if(!(val & (1<<ADEN)))
+    {
+      adcRemaining = 0;
+      val &= ~(1<<ADSC);
+    }
+    else if(adcRemaining > 0)
+    {
+      val |= 1<<ADSC;
+    }
+    else if(val & (1<<ADSC))
+    {
+      uint32_t prescaler = 1 << (val & 7);
+      if(prescaler < 2) prescaler = 2;
+      adcRemaining = (adcFirst ? 25 : 13) * prescaler;
+      adcFirst = 0;
+    }
+    io[0x7A] = val;
+  }
+
+  // EEPROM: EERE reads at once, EEMPE + EEPE starts a write
+  if(changed(0x3F))
+  {
+    uint8_t val = io[0x3F];
+    const uint16_t addr = (io[0x41] | (io[0x42] << 8)) & E2END;
+    if(val & (1<<EERE))
+    {
+      if(eepromRemaining == 0) io[0x40] = eeprom[addr];
+      val &= ~(1<<EERE);
+    }
+    if((val & (1<<EEPE)) && !(shadow[0x3F] & (1<<EEPE)))
+    {
+      if((shadow[0x3F] & (1<<EEMPE)) && eepromRemaining == 0)
+      {
+        const uint8_t mode = (val >> EEPM0) & 3;
+        if(mode == 0) eeprom[addr] = io[0x40];
+        else if(mode == 1) eeprom[addr] = 0xff;
+        else eeprom[addr] &= io[0x40];
+        eepromRemaining = mode == 0 ? SIM_EEPROM_WRITE_CYCLES : SIM_EEPROM_WRITE_CYCLES / 2;
+      }
+      else
+      {
+        val &= ~(1<<EEPE);
+      }
+    }
+    if(eepromRemaining > 0) val |= 1<<EEPE;
+    // EEMPE clears itself four cycles after it was set
+    if(shadow[0x3F] & (1<<EEMPE)) val &= ~(1<<EEMPE);
+    io[0x3F] = val;
+  }
+
+  memcpy(shadow, (const void*)io, sizeof(shadow));
+  if(pinsDirty) updatePins();
+}
+//-----------------------------------------------------------
+// timers
+//-----------------------------------------------------------
+static uint32_t prescalerOf(uint8_t timer, uint8_t cs)
+{
+  static const uint16_t t01[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+  static const uint16_t t2[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+  return timer == 2 ? t2[cs & 7] : t01[cs & 7];
+}
+//-----------------------------------------------------------
+// one clock of timer 0 or 2. modes with TOP = OCRA are 2, 5 and 7, phase correct modes count single slope
+static void clock8(uint8_t tccra, uint8_t tccrb, uint8_t tcnt, uint8_t ocra, uint8_t ocrb, uint8_t tifr)
+{
+  const uint8_t mode = ((io[tccrb] >> 1) & 4) | (io[tccra] & 3);
+  const uint8_t top = (mode == 2 || mode == 5 || mode == 7) ? io[ocra] : 0xff;
+
+  if(io[tcnt] == top)
+  {
+    io[tcnt] = 0;
+    if(top == 0xff || mode != 2) io[tifr] |= 1<<TOV0;
+  }
+  else
+  {
+    io[tcnt]++;
+  }
+  if(io[tcnt] == io[ocra]) io[tifr] |= 1<<OCF0A;
+  if(io[tcnt] == io[ocrb]) io[tifr] |= 1<<OCF0B;
+}
+//-----------------------------------------------------------
+static void clock16(void)
+{
+  const uint8_t mode = ((io[0x81] >> 1) & 0x0c) | (io[0x80] & 3);
+  const uint16_t ocra = io[0x88] | (io[0x89] << 8);
+  const uint16_t ocrb = io[0x8A] | (io[0x8B] << 8);
+  const uint16_t icr = io[0x86] | (io[0x87] << 8);
+  uint16_t tcnt = io[0x84] | (io[0x85] << 8);
+  uint16_t top;
+
+  switch(mode)
+  {
+    case 4: case 9: case 11: case 15: top = ocra; break;
+    case 8: case 10: case 12: case 14: top = icr; break;
+    case 1: case 5: top = 0x00ff; break;
+    case 2: case 6: top = 0x01ff; break;
+    case 3: case 7: top = 0x03ff; break;
+    default: top = 0xffff; break;
+  }
+  if(tcnt == top)
+  {
+    tcnt = 0;
+    if(mode != 4 && mode != 12) io[0x36] |= 1<<TOV1;
+    if(mode == 12) io[0x36] |= 1<<ICF1;
+  }
+  else
+  {
+    tcnt++;
+  }
+  if(tcnt == ocra) io[0x36] |= 1<<OCF1A;
+  if(tcnt == ocrb) io[0x36] |= 1<<OCF1B;
+  io[0x84] = tcnt & 0xff;
+  io[0x85] = tcnt >> 8;
+}
+//-----------------------------------------------------------
+static void runTimers(uint32_t n)
+{
+  static const uint8_t tccrb[3] = {0x45, 0x81, 0xB1};
+  for(uint8_t t=0;t<3;t++)
+  {
+    const uint32_t prescaler = prescalerOf(t, io[tccrb[t]]);
+    if(prescaler == 0) continue;
+    timerPrescaler[t] += n;
+    while(timerPrescaler[t] >= prescaler)
+    {
+      timerPrescaler[t] -= prescaler;
+      if(t == 0) clock8(0x44, 0x45, 0x46, 0x47, 0x48, 0x35);
+      else if(t == 1) clock16();
+      else clock8(0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0x37);
+    }
+  }
+}
+//-----------------------------------------------------------
+static void runPeripherals(uint32_t n)
+{
+  runTimers(n);
+
+  if(adcRemaining > 0 && (adcRemaining -= n) <= 0)
+  {
+    const uint8_t admux = io[0x7C];
+    uint16_t value = adcInput[admux & 7];
+    if(admux & (1<<ADLAR)) value <<= 6;
+    io[0x78] = value & 0xff;
+    io[0x79] = value >> 8;
+    io[0x7A] |= 1<<ADIF;
+    // free running mode starts the next conversion right away
+    if((io[0x7A] & (1<<ADATE)) && (io[0x7B] & 7) == 0)
+    {
+      uint32_t prescaler = 1 << (io[0x7A] & 7);
+      if(prescaler < 2) prescaler = 2;
+      adcRemaining = 13 * prescaler;
+    }
+    else
+    {
+      adcRemaining = 0;
+      io[0x7A] &= ~(1<<ADSC);
+    }
+  }
+
+  if(spiRemaining > 0 && (spiRemaining -= n) <= 0)
+  {
+    spiRemaining = 0;
+    // MISO is row 2 of the button matrix
+    const uint8_t miso = (pinState[PORT_B] & (1<<PB4)) ? 0xff : 0x00;
+    if(!(io[0x25] & (1<<MCP_CS_PIN)))
+    {
+      dacShift = (dacShift << 8) | spiData;
+      dacBits += 8;
+    }
+    io[0x4E] = miso;
+    io[0x4D] |= 1<<SPIF;
+  }
+
+  if(eepromRemaining > 0 && (eepromRemaining -= n) <= 0)
+  {
+    eepromRemaining = 0;
+    io[0x3F] &= ~(1<<EEPE);
+  }
+
+  // registers the peripherals above update
+  static const uint8_t touched[] = {0x35, 0x36, 0x37, 0x3F, 0x46, 0x4D, 0x4E, 0x78, 0x79, 0x7A, 0x84, 0x85, 0xB2};
+  for(uint8_t i=0;i<sizeof(touched);i++) shadow[touched[i]] = io[touched[i]];
+}
+//-----------------------------------------------------------
+static void runIsr(uint8_t vector)
+{
+  if(!vectors[vector]) fatal("interrupt without ISR, the AVR would reset", vector);
+
+  io[0x5F] = shadow[0x5F] &= ~(1<<SREG_I);
+  advance(SIM_ISR_CYCLES / 2);
+  if(isrHook) isrHook(vector, 1);
+  vectors[vector]();
+  if(isrHook) isrHook(vector, 0);
+  sync();
+  io[0x5F] = shadow[0x5F] |= 1<<SREG_I;
+  advance(SIM_ISR_CYCLES / 2);
+}
+//-----------------------------------------------------------
+// returns the highest priority (lowest) pending vector, 0 = none
+static uint8_t pendingVector(void)
+{
+  const uint8_t pcint = io[0x3B] & io[0x68];
+  const uint8_t t0 = io[0x35] & io[0x6E];
+  const uint8_t t1 = io[0x36] & io[0x6F];
+  const uint8_t t2 = io[0x37] & io[0x70];
+
+  if(pcint & 1) return 3;
+  if(pcint & 2) return 4;
+  if(pcint & 4) return 5;
+  if(t2 & (1<<OCF2A)) return 7;
+  if(t2 & (1<<OCF2B)) return 8;
+  if(t2 & (1<<TOV2)) return 9;
+  if(t1 & (1<<ICF1)) return 10;
+  if(t1 & (1<<OCF1A)) return 11;
+  if(t1 & (1<<OCF1B)) return 12;
+  if(t1 & (1<<TOV1)) return 13;
+  if(t0 & (1<<OCF0A)) return 14;
+  if(t0 & (1<<OCF0B)) return 15;
+  if(t0 & (1<<TOV0)) return 16;
+  if((io[0x4D] & (1<<SPIF)) && (io[0x4C] & (1<<SPIE))) return 17;
+  if((io[0x7A] & (1<<ADIF)) && (io[0x7A] & (1<<ADIE))) return 21;
+  if((io[0x3F] & (1<<EERIE)) && !(io[0x3F] & (1<<EEPE))) return 22;
+  return 0;
+}
+//-----------------------------------------------------------
+static void dispatch(void)
+{
+  uint8_t vector;
+  while((io[0x5F] & (1<<SREG_I)) && (vector = pendingVector()) != 0)
+  {
+    // the hardware clears the flag when the vector is taken
+    switch(vector)
+    {
+      case 3: case 4: case 5: io[0x3B] &= ~(1<<(vector-3)); break;
+      case 7: io[0x37] &= ~(1<<OCF2A); break;
+      case 8: io[0x37] &= ~(1<<OCF2B); break;
+      case 9: io[0x37] &= ~(1<<TOV2); break;
+      case 10: io[0x36] &= ~(1<<ICF1); break;
+      case 11: io[0x36] &= ~(1<<OCF1A); break;
+      case 12: io[0x36] &= ~(1<<OCF1B); break;
+      case 13: io[0x36] &= ~(1<<TOV1); break;
+      case 14: io[0x35] &= ~(1<<OCF0A); break;
+      case 15: io[0x35] &= ~(1<<OCF0B); break;
+      case 16: io[0x35] &= ~(1<<TOV0); break;
+      case 17: io[0x4D] &= ~(1<<SPIF); break;
+      case 21: io[0x7A] &= ~(1<<ADIF); break;
+    }
+    memcpy(shadow, (const void*)io, sizeof(shadow));
+    runIsr(vector);
+  }
+}
+//-----------------------------------------------------------
+static void advance(uint32_t n)
+{
+  // small steps so timer interrupts during long delays are not merged
+  while(n > 0)
+  {
+    const uint32_t step = n > 8 ? 8 : n;
+    runPeripherals(step);
+    cycles += step;
+    n -= step;
+
+    if(hook && !inHook && cycles >= nextHook)
+    {
+      nextHook += hookPeriod;
+      inHook = 1;
+      hook();
+      inHook = 0;
+    }
+    if(stopAt && cycles >= stopAt) sim_stop();
+    dispatch();
+  }
+}
+//-----------------------------------------------------------
+volatile uint8_t *sim_reg8(uint8_t addr)
+{
+  sync();
+  advance(SIM_ACCESS_CYCLES);
+  return &io[addr];
+}
+//-----------------------------------------------------------
+volatile uint16_t *sim_reg16(uint8_t addr)
+{
+  sync();
+  advance(SIM_ACCESS_CYCLES);
+  return (volatile uint16_t*)&io[addr];
+}
+//-----------------------------------------------------------
+void sim_sei(void)
+{
+  sync();
+  io[0x5F] = shadow[0x5F] |= 1<<SREG_I;
+  advance(1);
+}
+//-----------------------------------------------------------
+void sim_cli(void)
+{
+  sync();
+  io[0x5F] = shadow[0x5F] &= ~(1<<SREG_I);
+  advance(1);
+}
+//-----------------------------------------------------------
+void sim_delayCycles(uint32_t n)
+{
+  sync();
+  advance(n);
+}
+//-----------------------------------------------------------
+// EEPROM
+//-----------------------------------------------------------
+uint8_t *sim_getEeprom(void)
+{
+  return eeprom;
+}
+//-----------------------------------------------------------
+uint8_t sim_loadEeprom(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if(!f) return 0;
+  const size_t n = fread(eeprom, 1, sizeof(eeprom), f);
+  fclose(f);
+  return n == sizeof(eeprom);
+}
+//-----------------------------------------------------------
+uint8_t sim_saveEeprom(const char *path)
+{
+  FILE *f = fopen(path, "wb");
+  if(!f) return 0;
+  const size_t n = fwrite(eeprom, 1, sizeof(eeprom), f);
+  return fclose(f) == 0 && n == sizeof(eeprom);
+}
+//-----------------------------------------------------------
+// EEMEM variables are placed in their own section, their offset in it is the EEPROM address
+static uint16_t eepromAddr(const void *p)
+{
+  uintptr_t addr = (uintptr_t)p;
+  if(addr > E2END)
+  {
+    if(!__start_sim_eeprom) fatal("EEPROM access without EEMEM variables", 0);
+    addr = (const char*)p - __start_sim_eeprom;
+  }
+  if(addr > E2END) fatal("EEPROM address out of range", (int)addr);
+  return addr;
+}
+//-----------------------------------------------------------
+uint16_t sim_eepromAddr(const void *p)
+{
+  return eepromAddr(p);
+}
+//-----------------------------------------------------------
+static void eepromWait(void)
+{
+  sync();
+  while(eepromRemaining > 0) advance(SIM_ACCESS_CYCLES);
+}
+//-----------------------------------------------------------
+uint8_t eeprom_is_ready(void)
+{
+  sync();
+  advance(SIM_ACCESS_CYCLES);
+  return eepromRemaining == 0;
+}
+//-----------------------------------------------------------
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+  eepromWait();
+  for(size_t i=0;i<n;i++)
+  {
+    ((uint8_t*)dst)[i] = eeprom[eepromAddr((const uint8_t*)src + i)];
+    advance(4);
+  }
+}
+//-----------------------------------------------------------
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+  uint8_t val;
+  eeprom_read_block(&val, addr, 1);
+  return val;
+}
+//-----------------------------------------------------------
+uint16_t eeprom_read_word(const uint16_t *addr)
+{
+  uint16_t val;
+  eeprom_read_block(&val, addr, 2);
+  return val;
+}
+//-----------------------------------------------------------
+uint32_t eeprom_read_dword(const uint32_t *addr)
+{
+  uint32_t val;
+  eeprom_read_block(&val, addr, 4);
+  return val;
+}
+//-----------------------------------------------------------
+void eeprom_write_block(const void *src, void *dst, size_t n)
+{
+  for(size_t i=0;i<n;i++)
+  {
+    eepromWait();
+    eeprom[eepromAddr((uint8_t*)dst + i)] = ((const uint8_t*)src)[i];
+    eepromRemaining = SIM_EEPROM_WRITE_CYCLES;
+    io[0x3F] = shadow[0x3F] |= 1<<EEPE;
+    advance(4);
+  }
+}
+//-----------------------------------------------------------
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+  eeprom_write_block(&value, addr, 1);
+}
+//-----------------------------------------------------------
+void eeprom_write_word(uint16_t *addr, uint16_t value)
+{
+  eeprom_write_block(&value, addr, 2);
+}
+//-----------------------------------------------------------
+void eeprom_write_dword(uint32_t *addr, uint32_t value)
+{
+  eeprom_write_block(&value, addr, 4);
+}
+//-----------------------------------------------------------
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+  for(size_t i=0;i<n;i++)
+  {
+    uint8_t *p = (uint8_t*)dst + i;
+    if(eeprom_read_byte(p) != ((const uint8_t*)src)[i]) eeprom_write_byte(p, ((const uint8_t*)src)[i]);
+  }
+}
+//-----------------------------------------------------------
+void eeprom_update_byte(uint8_t *addr, uint8_t value)
+{
+  eeprom_update_block(&value, addr, 1);
+}
+//-----------------------------------------------------------
+void eeprom_update_word(uint16_t *addr, uint16_t value)
+{
+  eeprom_update_block(&value, addr, 2);
+}
+//-----------------------------------------------------------
+// board
+//-----------------------------------------------------------
+void sim_setAdcInput(uint8_t channel, uint16_t value)
+{
+  adcInput[channel & 7] = value & 0x3ff;
+}
+//-----------------------------------------------------------
+void sim_setCv(uint16_t value)
+{
+  sim_setAdcInput(0, value);
+}
+//-----------------------------------------------------------
+void sim_setTrigger(uint8_t active)
+{
+  sim_setPin('D', TRIGGER_PIN, !active);
+}
+//-----------------------------------------------------------
+void sim_setGateConnected(uint8_t connected)
+{
+  if(connected) sim_setPin('C', JACK_SWITCH_PIN, 0);
+  else sim_releasePin('C', JACK_SWITCH_PIN);
+}
+//-----------------------------------------------------------
+void sim_setButton(uint8_t nr, uint8_t pressed)
+{
+  if(pressed) buttons |= 1<<nr;
+  else buttons &= ~(1<<nr);
+  updatePins();
+}
+//-----------------------------------------------------------
+uint8_t sim_getDacOutput(uint8_t channel)
+{
+  return dacOutput[channel & 1];
+}
+//-----------------------------------------------------------
+uint32_t sim_getDacUpdates(void)
+{
+  return dacUpdates;
+}
+//-----------------------------------------------------------
+void sim_setDacHook(void (*h)(uint8_t channel, uint8_t value))
+{
+  dacHook = h;
+}
+//-----------------------------------------------------------
+uint8_t sim_isGateHigh(void)
+{
+  return !(io[0x25] & (1<<MCP_LDAC_PIN));
+}
+//-----------------------------------------------------------
+uint64_t sim_getLedCycles(uint8_t led, uint8_t colour)
+{
+  accountLeds();
+  return ledCycles[led*2 + (colour & 1)];
+}
+//-----------------------------------------------------------
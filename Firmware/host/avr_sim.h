@@ -0,0 +1,97 @@
+/*
+ * avr_sim.h
+ *
+ * Simulated atmega168 and Penrose board for the host build ('make host').
+ * The firmware sources are compiled unchanged against the headers in host/,
+ * every register access ends up in avr_sim.c which advances a simulated clock,
+ * runs timers, ADC, SPI and EEPROM and dispatches interrupts to the ISR()s.
+ *
+ * The model is functional, not cycle accurate: every register access costs
+ * SIM_ACCESS_CYCLES, interrupt entry + exit SIM_ISR_CYCLES. Code that spins on
+ * a RAM variable set by an ISR without touching any register never advances
+ * the clock.
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AVR_SIM_H_
+#define AVR_SIM_H_
+
+#include <stdint.h>
+
+#define SIM_ACCESS_CYCLES	2
+#define SIM_ISR_CYCLES		16
+#define SIM_EEPROM_WRITE_CYCLES	(F_CPU / 1000000UL * 3400) // 3.4ms erase + write
+
+//-----------------------------------------------------------
+// power on reset: registers cleared, EEPROM erased, all inputs released
+void sim_init(void);
+
+// simulated time since sim_init()
+uint64_t sim_getCycles(void);
+double sim_getSeconds(void);
+
+/* runs entry (the firmware main(), renamed to avr_main in the host build)
+ * until maxCycles have been simulated or sim_stop() is called.
+ * maxCycles = 0 runs until sim_stop()
+ */
+void sim_run(int (*entry)(void), uint64_t maxCycles);
+void sim_stop(void);
+
+// hook is called every periodCycles simulated cycles, e.g. to drive inputs
+void sim_setHook(void (*hook)(void), uint32_t periodCycles);
+// called before (enter=1) and after (enter=0) every interrupt service routine
+void sim_setIsrHook(void (*hook)(uint8_t vector, uint8_t enter));
+
+//-----------------------------------------------------------
+// generic pins and peripherals
+
+// drives an input pin from outside, port = 'B', 'C' or 'D'
+void sim_setPin(char port, uint8_t pin, uint8_t level);
+// stop driving the pin, it reads its pullup again
+void sim_releasePin(char port, uint8_t pin);
+// value converted by the ADC for channel, 0..1023
+void sim_setAdcInput(uint8_t channel, uint16_t value);
+
+uint8_t *sim_getEeprom(void);
+uint8_t sim_loadEeprom(const char *path);
+uint8_t sim_saveEeprom(const char *path);
+
+//-----------------------------------------------------------
+// Penrose board
+
+// CV input (ADC0), 0..1023
+void sim_setCv(uint16_t value);
+// trigger jack, the input stage inverts so an active trigger reads low on PD7
+void sim_setTrigger(uint8_t active);
+// jack switch on PC4, pulled low while a cable is plugged into the gate input
+void sim_setGateConnected(uint8_t connected);
+// button 0..11 of the matrix, row = nr/4, column = nr%4
+void sim_setButton(uint8_t nr, uint8_t pressed);
+
+// MCP4802 output register of channel 0 (A) or 1 (B), 8 bit
+uint8_t sim_getDacOutput(uint8_t channel);
+// number of output register updates (LDAC pulses or writes with LDAC low)
+uint32_t sim_getDacUpdates(void);
+// called on every DAC output update
+void sim_setDacHook(void (*hook)(uint8_t channel, uint8_t value));
+// LDAC doubles as the gate output: LDAC low = gate high
+uint8_t sim_isGateHigh(void);
+
+// cycles LED 0..11 was lit in colour 0 (playing) or 1 (active step)
+uint64_t sim_getLedCycles(uint8_t led, uint8_t colour);
+
+#endif /* AVR_SIM_H_ */
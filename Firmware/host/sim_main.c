@@ -0,0 +1,204 @@
+/*
+ * sim_main.c
+ *
+ * runs the quantizer firmware on the simulated board ('make host')
+ *
+ *  quantizer-host [-t seconds] [-c cv | -r] [-g hz] [-s mask] [-e eeprom.bin] [-v] [-d seconds]
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "avr_sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "eeprom.h"
+#include "events.h"
+#include "timebase.h"
+#include "scheduler.h"
+
+int avr_main(void);
+
+#define HOOK_PERIOD	(F_CPU / 10000)	// 100us
+
+static double duration = 2.;
+static int cv = -1;			// -1 = ramp over the full range
+static double triggerRate = 0;		// 0 = continuous mode
+static uint8_t verbose = 0;
+static double dumpInterval = 0;		// 0 = task stats only at the end
+static uint64_t nextDump;
+static uint64_t nextTrigger;
+static uint32_t triggers;
+static uint64_t triggerCycle;
+static uint8_t triggerPending;
+static uint32_t latencies;
+static uint64_t latencyTotal, latencyMax, latencyMin = (uint64_t)-1;
+//-----------------------------------------------------------
+static void usage()
+{
+  printf("usage: quantizer-host [options]\n");
+  printf("  -t SECONDS   simulated time (default 2)\n");
+  printf("  -c VALUE     fixed CV input, ADC value 0..1023 (default: ramp over the full range)\n");
+  printf("  -g HZ        plug in the gate input and trigger at HZ (default: continuous mode)\n");
+  printf("  -s MASK      active steps to store in EEPROM before power up, e.g. 0xab5\n");
+  printf("  -e FILE      EEPROM image, loaded before and saved after the run\n");
+  printf("  -v           print every DAC update of both outputs\n");
+  printf("  -d SECONDS   debug dump of the task stats every SECONDS\n");
+}
+//-----------------------------------------------------------
+static void dumpTasks()
+{
+  printf("%-10s %8s %7s %7s %7s %9s %6s %6s   [cycles]\n", "task", "runs", "avg", "max", "budget", "max delay", "over", "missed");
+  for(uint8_t i=0;i<sched_getTaskCount();i++)
+  {
+    const Task *task = sched_getTask(i);
+    const TaskStats *stats = sched_getStats(i);
+    printf("%-10s %8u %7u %7u %7u %9u %6u %6u\n", task->name, stats->runs,
+	   sched_getAverage(i) * TASK_TICK_CYCLES, stats->maxTime * TASK_TICK_CYCLES, task->budget * TASK_TICK_CYCLES,
+	   stats->maxDelay * TASK_TICK_CYCLES, stats->overruns, stats->misses);
+  }
+}
+//-----------------------------------------------------------
+static void hook()
+{
+  const double t = sim_getSeconds();
+  if(cv < 0) sim_setCv((uint16_t)(t / duration * 1023));
+
+  if(dumpInterval > 0 && sim_getCycles() >= nextDump)
+  {
+    nextDump += (uint64_t)(dumpInterval * F_CPU);
+    printf("--- %.3f s\n", t);
+    dumpTasks();
+  }
+
+  if(triggerRate > 0)
+  {
+    if(sim_getCycles() >= nextTrigger)
+    {
+      sim_setTrigger(1);
+      triggers++;
+      triggerCycle = sim_getCycles();
+      triggerPending = 1;
+      nextTrigger += (uint64_t)(F_CPU / triggerRate);
+    }
+    else
+    {
+      sim_setTrigger(0);
+    }
+  }
+}
+//-----------------------------------------------------------
+static void dacHook(uint8_t channel, uint8_t value)
+{
+  if(triggerPending && channel == 0)
+  {
+    const uint64_t latency = sim_getCycles() - triggerCycle;
+    triggerPending = 0;
+    latencies++;
+    latencyTotal += latency;
+    if(latency > latencyMax) latencyMax = latency;
+    if(latency < latencyMin) latencyMin = latency;
+  }
+  // an LDAC pulse updates A, then B
+  if(verbose && channel == 1)
+  {
+    const uint8_t a = sim_getDacOutput(0);
+    printf("%10.6f s  dac %3d  note %2d octave %d  B %3d  note %2d octave %d\n", sim_getSeconds(), a, (a/2)%12, (a/2)/12,
+	   value, (value/2)%12, (value/2)/12);
+  }
+}
+//-----------------------------------------------------------
+int main(int argc, char **argv)
+{
+  const char *eepromFile = NULL;
+  int steps = -1;
+
+  for(int i=1;i<argc;i++)
+  {
+    if(!strcmp(argv[i], "-t") && i+1 < argc) duration = atof(argv[++i]);
+    else if(!strcmp(argv[i], "-c") && i+1 < argc) cv = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-g") && i+1 < argc) triggerRate = atof(argv[++i]);
+    else if(!strcmp(argv[i], "-s") && i+1 < argc) steps = strtol(argv[++i], NULL, 0) & 0xfff;
+    else if(!strcmp(argv[i], "-e") && i+1 < argc) eepromFile = argv[++i];
+    else if(!strcmp(argv[i], "-v")) verbose = 1;
+    else if(!strcmp(argv[i], "-d") && i+1 < argc) dumpInterval = atof(argv[++i]);
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  sim_init();
+  if(eepromFile) sim_loadEeprom(eepromFile);
+  if(steps >= 0)
+  {
+    eeprom_ReadBuffer();
+    eeprom_WriteBuffer(steps);
+    eeprom_Flush();
+  }
+  if(cv >= 0) sim_setCv(cv);
+  sim_setGateConnected(triggerRate > 0);
+  sim_setDacHook(dacHook);
+  sim_setHook(hook, HOOK_PERIOD);
+  nextTrigger = sim_getCycles() + F_CPU / 100;
+  nextDump = sim_getCycles() + (uint64_t)(dumpInterval * F_CPU);
+
+  const clock_t start = clock();
+  sim_run(avr_main, (uint64_t)(duration * F_CPU));
+  const double hostTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  if(eepromFile && !sim_saveEeprom(eepromFile))
+  {
+    printf("   Can't write EEPROM image '%s'.\n", eepromFile);
+  }
+
+  printf("simulated     %.3f s (%llu cycles) in %.3f s host time, %.1fx real time\n",
+	 sim_getSeconds(), (unsigned long long)sim_getCycles(), hostTime, hostTime > 0 ? sim_getSeconds() / hostTime : 0);
+  printf("mode          %s\n", triggerRate > 0 ? "triggered" : "continuous");
+  if(triggerRate > 0) printf("triggers      %u\n", triggers);
+  if(latencies)
+  {
+    printf("trigger->dac  %llu/%llu/%llu cycles min/avg/max (host model)\n", (unsigned long long)latencyMin,
+	   (unsigned long long)(latencyTotal / latencies), (unsigned long long)latencyMax);
+  }
+  if(triggerRate > 0)
+  {
+    const EventStats *stats = event_getStats();
+    printf("retrigger queue %u serviced, max depth %u, %u dropped, worst latency %.1f us\n", stats->serviced,
+	   stats->maxDepth, stats->overflows, stats->maxLatency * 1000. / TIMER_TICKS_PER_MS);
+  }
+  else
+  {
+    const ControlStats *stats = timer_getControlStats();
+    printf("control loop  %u runs at %d Hz, %u missed, start %.1f..%.1f us after the tick (jitter %.1f us)\n",
+	   stats->runs, CONTROL_RATE, stats->missed, stats->minLate * 3.2, stats->maxLate * 3.2,
+	   (stats->maxLate - stats->minLate) * 3.2);
+  }
+  printf("dac updates   %u, last value %d / %d (A / B)\n", sim_getDacUpdates(), sim_getDacOutput(0), sim_getDacOutput(1));
+  printf("led duty      ");
+  for(uint8_t i=0;i<12;i++)
+  {
+    const double on = (double)(sim_getLedCycles(i, 0) + sim_getLedCycles(i, 1)) / sim_getCycles();
+    printf("%4.1f%% ", on * 100);
+  }
+  printf("\n");
+  dumpTasks();
+  return 0;
+}
+//-----------------------------------------------------------
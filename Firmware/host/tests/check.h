@@ -0,0 +1,50 @@
+/*
+ * check.h
+ *
+ * assertions for the host tests in host/tests ('make check')
+ * a failed check prints where and what, the test keeps running and exits with 1
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      check_failures++; \
+    } \
+  } while(0)
+
+// integer compare, both values are printed in hex on failure
+#define CHECK_EQ(actual, expected) do { \
+    const long long a_ = (actual), e_ = (expected); \
+    if(a_ != e_) { \
+      printf("%s:%d: check failed: %s == %s (0x%llx, expected 0x%llx)\n", __FILE__, __LINE__, #actual, #expected, a_, e_); \
+      check_failures++; \
+    } \
+  } while(0)
+
+// end of main()
+#define CHECK_RESULT(name) \
+  (printf("%s: %s\n", name, check_failures ? "FAILED" : "ok"), check_failures ? 1 : 0)
+
+#endif /* CHECK_H_ */
@@ -0,0 +1,110 @@
+/*
+ * test_buttons.c
+ *
+ * button matrix, debouncing, long press and autosave on the simulated board:
+ * a bouncing press toggles its step once, a 2ms glitch is ignored, a long press
+ * switches the quantizer mode and takes back the step its press toggled, the
+ * autosave stores steps and mode and the next power up restores them
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "avr_sim.h"
+#include "check.h"
+#include <string.h>
+
+#include "IoMatrix.h"
+#include "eeprom.h"
+#include "timebase.h"
+
+int avr_main(void);
+
+#define HOOK_PERIOD	(F_CPU / 10000)	// 100us
+
+typedef struct {
+  double time;
+  uint16_t steps;
+  uint8_t mode;
+  uint8_t taken;
+} Snapshot;
+
+// state expected at these times of the first run
+static Snapshot snapshots[] = {
+  {0.30,	0xff7,	QUANT_MODE_UP,		0},	// bouncing press and release of button 3
+  {1.20,	0xfd7,	QUANT_MODE_UP,		0},	// button 5 pressed, not long yet
+  {2.10,	0xff7,	QUANT_MODE_NEAREST,	0},	// long press: mode switched, step 5 back
+  {2.50,	0xff7,	QUANT_MODE_NEAREST,	0},	// 2ms glitch on button 7
+};
+#define NUM_SNAPSHOTS (sizeof(snapshots)/sizeof(snapshots[0]))
+
+//-----------------------------------------------------------
+// 4kHz square wave, bounce of a mechanical contact
+static uint8_t bounce(double t)
+{
+  return (int)(t*4000) & 1;
+}
+//-----------------------------------------------------------
+static void hook(void)
+{
+  const double t = sim_getSeconds();
+  
+  uint8_t b3 = t >= 0.103 && t < 0.2;
+  if((t >= 0.1 && t < 0.103) || (t >= 0.2 && t < 0.203)) b3 = bounce(t);
+  sim_setButton(3, b3);
+  sim_setButton(5, t > 0.5 && t < 2.0);
+  sim_setButton(7, t > 2.2 && t < 2.202);
+  
+  for(unsigned int i=0;i<NUM_SNAPSHOTS;i++)
+  {
+    Snapshot *s = &snapshots[i];
+    if(s->taken || t < s->time) continue;
+    s->taken = 1;
+    if(io_getActiveSteps() != s->steps || io_getQuantMode() != s->mode)
+    {
+      printf("at %.2fs: steps %03x mode %d, expected %03x mode %d\n", t, io_getActiveSteps(), io_getQuantMode(), s->steps, s->mode);
+      check_failures++;
+    }
+  }
+}
+//-----------------------------------------------------------
+int main(void)
+{
+  uint8_t eeprom[512];
+  
+  // erased EEPROM, the last change is at 2s, so the autosave is due at 17s
+  sim_init();
+  sim_setCv(300);
+  sim_setHook(hook, HOOK_PERIOD);
+  sim_run(avr_main, F_CPU * (2 + AUTOSAVE_TIME + 2));
+  for(unsigned int i=0;i<NUM_SNAPSHOTS;i++) CHECK(snapshots[i].taken);
+  CHECK_EQ(io_getKeyLong(KEY_ALL), 0);
+  
+  // the record in EEPROM
+  memcpy(eeprom, sim_getEeprom(), sizeof(eeprom));
+  CHECK_EQ(eeprom_ReadBuffer(), 0xff7);
+  CHECK_EQ(eeprom_getState()->mode, QUANT_MODE_NEAREST);
+  
+  // power cycle with the EEPROM contents kept and no button pressed
+  sim_init();
+  sim_setHook(NULL, 0);
+  memcpy(sim_getEeprom(), eeprom, sizeof(eeprom));
+  sim_setCv(300);
+  sim_run(avr_main, F_CPU / 2);
+  CHECK_EQ(io_getActiveSteps(), 0xff7);
+  CHECK_EQ(io_getQuantMode(), QUANT_MODE_NEAREST);
+  
+  return CHECK_RESULT("test_buttons");
+}
@@ -0,0 +1,102 @@
+/*
+ * test_eeprom_legacy.c
+ *
+ * power up with the EEPROM contents the first firmware left behind:
+ * uint8_t statusBuffer[128] at 0x000 and uint16_t dataBuffer[128] at 0x080,
+ * the placement the shipped quantizer.hex of that firmware uses.
+ * The images are produced by the write routine of that firmware, the current
+ * one has to load the last stored step mask and keep it over the migration.
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "avr_sim.h"
+#include "check.h"
+#include <string.h>
+
+#include "IoMatrix.h"
+#include "eeprom.h"
+
+int avr_main(void);
+
+#define LEGACY_STATUS_ADDR	0x000
+#define LEGACY_DATA_ADDR	0x080
+#define LEGACY_BUFFER_MASK	0x7f
+
+//-----------------------------------------------------------
+// eeprom_WriteBuffer() of the first firmware on a raw image, addr is its currentEepromAddress
+static void legacyWrite(uint8_t *eeprom, uint8_t *addr, uint16_t data)
+{
+  const uint16_t stored = eeprom[LEGACY_DATA_ADDR + 2*(*addr)] | (eeprom[LEGACY_DATA_ADDR + 2*(*addr) + 1] << 8);
+  if(stored == data) return;
+  
+  uint8_t status = eeprom[LEGACY_STATUS_ADDR + *addr];
+  *addr = (*addr+1)&LEGACY_BUFFER_MASK;
+  eeprom[LEGACY_DATA_ADDR + 2*(*addr)] = data & 0xff;
+  eeprom[LEGACY_DATA_ADDR + 2*(*addr) + 1] = data >> 8;
+  status += 1;
+  eeprom[LEGACY_STATUS_ADDR + *addr] = status;
+}
+//-----------------------------------------------------------
+// power up on image, returns the active steps after the firmware started
+static uint16_t powerUp(const uint8_t *image)
+{
+  sim_init();
+  memcpy(sim_getEeprom(), image, 512);
+  sim_setCv(300);
+  sim_run(avr_main, F_CPU / 10);
+  return io_getActiveSteps();
+}
+//-----------------------------------------------------------
+int main(void)
+{
+  static const int writeCounts[] = {0, 1, 2, 127, 128, 129, 200, 255, 256, 300, 1000};
+  uint8_t image[512];
+  
+  for(unsigned int i=0;i<sizeof(writeCounts)/sizeof(writeCounts[0]);i++)
+  {
+    // erased EEPROM, then the saves of the first firmware, every mask different from the one before
+    memset(image, 0xff, sizeof(image));
+    uint8_t addr = 0;
+    uint16_t last = 0xfff;		// an erased data word reads as all steps
+    for(int n=0;n<writeCounts[i];n++)
+    {
+      last = (0x5a5 + n*0x123) & 0xfff;
+      if(last == 0) last = 1;
+      legacyWrite(image, &addr, last);
+    }
+    
+    const uint16_t steps = powerUp(image);
+    if(steps != last)
+    {
+      printf("%d legacy writes: steps %03x, expected %03x\n", writeCounts[i], steps, last);
+      check_failures++;
+    }
+    
+    // a change is stored in the new layout and survives the next power up
+    uint8_t migrated[512];
+    io_setActiveSteps(last ^ 0x801);
+    CHECK_EQ(eeprom_WriteBuffer(last ^ 0x801), 1);
+    eeprom_Flush();
+    memcpy(migrated, sim_getEeprom(), sizeof(migrated));
+    CHECK_EQ(powerUp(migrated), last ^ 0x801);
+    
+    // the first new record goes behind the old data, a power loss during it falls back to them
+    CHECK(memcmp(migrated, image, 3*128) == 0);
+  }
+  
+  return CHECK_RESULT("test_eeprom_legacy");
+}
@@ -0,0 +1,98 @@
+/*
+ * test_quantizer.c
+ *
+ * quantizeValue() against the straightforward kernel it replaced: true divisions
+ * and a search over the notes of the step mask instead of the reciprocal
+ * multiplications and the step offset tables. Every non-empty mask, every 12 bit
+ * input and both quantizer modes must give the same DAC value.
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "avr_sim.h"
+#include "check.h"
+
+#include "IoMatrix.h"
+
+uint8_t quantizeValue(uint16_t input);
+
+#define MAX_REPORTED	10
+
+//-----------------------------------------------------------
+/* the search kernel of the first firmware, with the input scaling of the 12 bit ADC value
+ * (input = 4*adc gives the old ((adc+1)*2+8)/17) and the nearest mode added
+ */
+static uint8_t referenceQuantize(uint16_t input, uint16_t steps, uint8_t mode)
+{
+  const unsigned int x = (input>>1)+10;
+  const unsigned int quantValue = x/17;
+  const unsigned int note = quantValue%12;
+  
+  //lowest active note at or above note
+  unsigned int up = 0;
+  while(!(steps & (1<<((note+up)%12)))) up++;
+  
+  //highest active note at or below note, not below 0
+  unsigned int down = 0;
+  while(!(steps & (1<<((note+12-down)%12)))) down++;
+  
+  if(mode==QUANT_MODE_NEAREST && down<=quantValue && (down<up || (down==up && x%17<9)))
+  {
+    return (quantValue-down)*2;
+  }
+  return (quantValue+up)*2;
+}
+//-----------------------------------------------------------
+int main(void)
+{
+  long compared = 0;
+  
+  sim_init();
+  
+  // the old 10 bit scaling
+  for(uint16_t adc=0;adc<1024;adc++)
+  {
+    CHECK_EQ(((4*adc>>1)+10)/17, ((adc+1)*2+8)/17);
+  }
+  
+  for(uint8_t mode=QUANT_MODE_UP;mode<=QUANT_MODE_NEAREST;mode++)
+  {
+    io_setQuantMode(mode);
+    for(uint16_t steps=1;steps<=0xfff;steps++)
+    {
+      io_setActiveSteps(steps);
+      for(uint16_t input=0;input<4096;input++)
+      {
+	//move out of the hysteresis window first
+	quantizeValue(input<2048 ? input+2048 : input-2048);
+	const uint8_t actual = quantizeValue(input);
+	const uint8_t expected = referenceQuantize(input, steps, mode);
+	if(actual != expected && check_failures++ < MAX_REPORTED)
+	{
+	  printf("mode %d steps %03x input %d: %d, expected %d\n", mode, steps, input, actual, expected);
+	}
+	compared++;
+      }
+    }
+  }
+  printf("%ld values compared\n", compared);
+  
+  // no active step
+  io_setActiveSteps(0);
+  CHECK_EQ(quantizeValue(1000), 0);
+  
+  return CHECK_RESULT("test_quantizer");
+}
@@ -0,0 +1,126 @@
+/*
+ * test_trigger.c
+ *
+ * trigger to LDAC latency on the simulated board. With the gate low the pin
+ * change ISR latches the preloaded note itself, so every such trigger must
+ * update the DAC within TRIGGER_LATENCY_MAX cycles, wherever the main loop is.
+ * Retriggers within the gate time go through the main loop and have to be
+ * served without losing one.
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "avr_sim.h"
+#include "check.h"
+
+#include "events.h"
+#include "timebase.h"
+
+int avr_main(void);
+
+#define HOOK_PERIOD		(F_CPU / 20000)		// 50us
+#define TRIGGER_PERIOD		(F_CPU / 50)		// longer than the gate
+#define RETRIGGER_PERIOD	(F_CPU / 2000)		// within the gate time
+
+// PCINT2 entry to LDAC (23 in the model) behind the longest other interrupt
+// (LED refresh, 30 + SIM_ISR_CYCLES) or interrupts-off section in the main loop
+#define TRIGGER_LATENCY_MAX	80
+
+static uint64_t period;
+static uint64_t nextTrigger;
+static uint64_t triggerCycle;
+static uint8_t triggerPending;
+static uint8_t gateAtTrigger;
+static uint32_t triggers, retriggers, updates, lateUpdates;
+static uint64_t latencyMax;
+static uint64_t gateLowLatencyMax;
+static uint16_t cv;
+
+//-----------------------------------------------------------
+static void hook(void)
+{
+  if(sim_getCycles() < nextTrigger)
+  {
+    sim_setTrigger(0);
+    return;
+  }
+  nextTrigger += period;
+  
+  // every trigger changes the note, so each one has to show up at the DAC
+  if(triggerPending) lateUpdates++;
+  gateAtTrigger = sim_isGateHigh();
+  if(gateAtTrigger) retriggers++;
+  triggerCycle = sim_getCycles();
+  triggerPending = 1;
+  triggers++;
+  sim_setTrigger(1);
+  
+  // the note for the next trigger, alternating between two octaves
+  cv = cv == 300 ? 500 : 300;
+  sim_setCv(cv);
+}
+//-----------------------------------------------------------
+static void dacHook(uint8_t channel, uint8_t value)
+{
+  (void)value;
+  if(channel != 0 || !triggerPending) return;
+  triggerPending = 0;
+  updates++;
+  
+  const uint64_t latency = sim_getCycles() - triggerCycle;
+  if(latency > latencyMax) latencyMax = latency;
+  if(!gateAtTrigger && latency > gateLowLatencyMax) gateLowLatencyMax = latency;
+}
+//-----------------------------------------------------------
+static void run(uint64_t triggerPeriod, double seconds)
+{
+  sim_init();
+  sim_setGateConnected(1);
+  cv = 300;
+  sim_setCv(cv);
+  period = triggerPeriod;
+  nextTrigger = F_CPU / 10;	// after the ADC filter settled
+  triggerPending = 0;
+  triggers = retriggers = updates = lateUpdates = 0;
+  latencyMax = gateLowLatencyMax = 0;
+  sim_setHook(hook, HOOK_PERIOD);
+  sim_setDacHook(dacHook);
+  sim_run(avr_main, (uint64_t)(F_CPU * seconds));
+}
+//-----------------------------------------------------------
+int main(void)
+{
+  // the gate is always low at the trigger, the ISR latches
+  run(TRIGGER_PERIOD, 2.01);
+  printf("gate low: %u triggers, %u updates, max %llu cycles\n", triggers, updates, (unsigned long long)gateLowLatencyMax);
+  CHECK_EQ(triggers, 96);
+  CHECK_EQ(retriggers, 0);
+  CHECK_EQ(lateUpdates, 0);
+  CHECK_EQ(updates, triggers);
+  CHECK(gateLowLatencyMax <= TRIGGER_LATENCY_MAX);
+  
+  // retriggers every 0.5ms, served by the main loop. The ADC filter does not
+  // settle between them, so not every one changes the note: count the queue
+  const uint16_t serviced = event_getStats()->serviced;
+  run(RETRIGGER_PERIOD, 1.0002);
+  printf("retrigger: %u triggers, %u queued, max %llu cycles\n", triggers, retriggers, (unsigned long long)latencyMax);
+  CHECK(retriggers > 1500);
+  CHECK_EQ((uint16_t)(event_getStats()->serviced - serviced), retriggers);
+  CHECK_EQ(event_getStats()->overflows, 0);
+  CHECK_EQ(event_getDepth(), 0);
+  
+  return CHECK_RESULT("test_trigger");
+}
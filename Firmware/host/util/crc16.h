@@ -0,0 +1,39 @@
+/*
+ * util/crc16.h (host build)
+ *
+ * the C equivalents of the avr-libc inline assembler versions
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_UTIL_CRC16_H_
+#define HOST_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+// polynomial x^16 + x^15 + x^2 + 1 (0xA001), initial value 0xffff
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a)
+{
+  crc ^= a;
+  for(uint8_t i=0;i<8;++i)
+  {
+    if(crc & 1) crc = (crc >> 1) ^ 0xA001;
+    else crc = (crc >> 1);
+  }
+  return crc;
+}
+
+#endif /* HOST_UTIL_CRC16_H_ */
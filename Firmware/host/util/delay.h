@@ -0,0 +1,32 @@
+/*
+ * util/delay.h (host build)
+ *
+ * busy waits advance the simulated clock
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+#include <stdint.h>
+
+void sim_delayCycles(uint32_t cycles);
+
+#define _delay_us(us)		sim_delayCycles((uint32_t)((us) * (F_CPU / 1000000.0)))
+#define _delay_ms(ms)		sim_delayCycles((uint32_t)((ms) * (F_CPU / 1000.0)))
+
+#endif /* HOST_UTIL_DELAY_H_ */
@@ -27,15 +27,19 @@
 #include "IoMatrix.h"
 #include "eeprom.h"
 #include "timebase.h"
+#include "events.h"
+#include "scheduler.h"
 #include <util/delay.h> 
 #include <avr/interrupt.h>  
+#include <avr/pgmspace.h>
 #include <stdlib.h>
 
 //-----------------------------------------------------------
 uint8_t quantizeValue(uint16_t input);
 void gateOut(uint8_t onOff);
-volatile uint8_t lastQuantValue = 0;
+volatile uint8_t lastQuantValue = 0;		//value on the DAC output
 volatile uint8_t gateTimer = 0;
+volatile uint8_t dacLoaded = 0;			//value in the DAC input register
 //-----------------------------------------------------------
 
 #define TRIGGER_INPUT_PIN		PD7
@@ -57,6 +61,8 @@ volatile uint8_t gateTimer = 0;
 
 
 #define GATE_IN_CONNECTED ((SWITCH_IN_PORT & (1<<SWITCH_PIN))==0)
+//LDAC doubles as gate output
+#define GATE_OUT_HIGH ((MCP_CS_PORT & (1<<MCP_LDAC_PIN))==0)
 //-----------------------------------------------------------
 void init()
 {
@@ -93,42 +99,140 @@ void init()
     sei();
 }
 //-----------------------&= ------------------------------------
+//distance from note to the next active step above it, 1..12
+static inline uint8_t nextStep(const uint8_t note)
+{
+	return io_getStepOffset(note==11 ? 0 : note+1) + 1;
+}
+//-----------------------------------------------------------
+/* output B: harmony voice two active steps above the note on output A
+ * (a diatonic third if a 7 note scale is lit), an octave lower if it does not fit the DAC
+ */
+static uint8_t harmonyValue(const uint8_t quantValue)
+{
+	if(io_getActiveSteps()==0) return 0;
+	
+	const uint8_t value = quantValue>>1;
+	//(q*43)>>9 == q/12 for q <= 130
+	uint8_t note = value-((value*43)>>9)*12;
+	
+	uint8_t up = nextStep(note);
+	note += up;
+	if(note>=12) note -= 12;
+	up += nextStep(note);
+	
+	uint8_t harmony = value+up;
+	while(harmony>127) harmony -= 12;
+	return harmony*2;
+}
+//-----------------------------------------------------------
 void process()
 {
-	const uint8_t quantValue = quantizeValue(adc_read()+1);
+	const uint8_t quantValue = quantizeValue(adc_getValue());
 	//if the value changed
 	if(lastQuantValue != quantValue)
 	{
 		lastQuantValue = quantValue;
-		mcp4802_outputData(quantValue,0);
+		dacLoaded = quantValue;
+		mcp4802_outputData(quantValue,harmonyValue(quantValue));
+		//start gate off timer
+		timer0_start();
+	}
+}
+//-----------------------------------------------------------
+//output the preloaded value if it is a new note, LDAC must be high (gate low), interrupts are off
+static inline void latchNote()
+{
+	if(dacLoaded != lastQuantValue)
+	{
+		mcp4802_latch();
+		lastQuantValue = dacLoaded;
 		//start gate off timer
 		timer0_start();
 	}
 }
 //-----------------------------------------------------------
+/* triggered mode:
+ * the input of the DAC is kept loaded with the current note, a trigger only has to latch it.
+ * The input register can only be written while the gate is low, with LDAC low the output
+ * would follow immediately. A latch waiting for the end of a transfer counts as gate high.
+ * The trigger ISR latches, so the check and the write must not be split by it.
+ */
+void preload()
+{
+	const uint8_t quantValue = quantizeValue(adc_getValue());
+	if(quantValue == dacLoaded) return;
+	const uint8_t harmony = harmonyValue(quantValue);
+	
+	const uint8_t sreg = SREG;
+	cli();
+	if(!GATE_OUT_HIGH && !mcp4802_isLatchPending())
+	{
+	  mcp4802_loadData(quantValue,harmony);
+	  dacLoaded = quantValue;
+	}
+	SREG = sreg;
+}
+//-----------------------------------------------------------
+/* retrigger dispatcher, called from the main loop
+ * a retrigger within the gate time has nothing preloaded, it quantizes and transfers
+ * the note here. Its service latency is bounded by the longest main loop iteration.
+ */
+void serviceTriggers()
+{
+	uint16_t stamp;
+	while(event_pop(&stamp))
+	{
+	  if(GATE_OUT_HIGH)
+	  {
+	    process();
+	  }
+	  else
+	  {
+	    //the gate ended while the event waited, the next note may be preloaded by now
+	    cli();
+	    latchNote();
+	    sei();
+	  }
+	}
+}
+//-----------------------------------------------------------
+/* a trigger with the gate low latches the preloaded note right here, the LDAC pulse
+ * only waits for the interrupt entry or a running SPI word. Retriggers go to the main loop.
+ */
 ISR(PCINT2_vect)
 {
     if(bit_is_clear(PIND,7)) //only rising edge
     {
-	process();	
+	if(GATE_OUT_HIGH || mcp4802_isLatchPending())
+	{
+	  event_push(timer_now());
+	}
+	else
+	{
+	  latchNote();
+	}
     }	
     return;	
 };
 //-----------------------------------------------------------
-static uint8_t lastInput=0;
+static uint16_t lastInput=0;
+static uint8_t lastQuantResult=0;	//last returned value, the output may still hold an older one
 uint8_t quantizeValue(uint16_t input)
 {
   if(io_getActiveSteps()==0)
   {
     //no stepselected
     io_setCurrentQuantizedValue(99); //no active step LED
+    lastQuantResult = 0;
     return 0;
   }
   
-  if(abs(input-lastInput) >= 2)
+  //input is the 12 bit filtered ADC value, the hysteresis is 2 LSB of the 10 bit ADC
+  if(abs(input-lastInput) >= 8)
   {
     lastInput = input;
-  } else return lastQuantValue;
+  } else return lastQuantResult;
   
 	//quantize input value to all steps
 	/* instead of input/ADC_STEPS_PER_NOTE we use the magic number 17 here.
@@ -138,55 +242,118 @@ uint8_t quantizeValue(uint16_t input)
 	 * to bring the note values (played by keyboard fr example) in the middle of a step, 
 	 * thus increasing the note tracking over several octaves
 	 */
-	uint8_t quantValue = ((input<<1)+8)/17;//ADC_STEPS_PER_NOTE;
+	/* with the 12 bit input (4*adc) this is ((adc+1)*2+8)/17 = ((input>>1)+10)/17
+	 * the AVR has no divider, x/17 is done as (x*3856)>>16
+	 * which is exact for x < 4097 (input <= 4092 gives x <= 2056)
+	 */
+	const uint16_t x = (input>>1)+10;
+	uint8_t quantValue = (x*3856UL)>>16;//ADC_STEPS_PER_NOTE;
 
-	//calculate the current active step
-	uint8_t octave = quantValue/12;
+	//calculate the current active step, (q*43)>>9 == q/12 for q <= 130
+	uint8_t octave = (quantValue*43)>>9;
 	uint8_t note = quantValue-(octave*12);
 
-	
 	//quantize to active steps
-	//search for the lowest matching activated note (lit led)
-	int i=0;
-	for(;i<13;i++)
+	//the lowest activated note (lit led) at or above note is offset steps away
+	const uint8_t offset = io_getStepOffset(note);
+	
+	//nearest mode: the highest activated note at or below note is down steps away
+	//on a tie the half of the note step the input is in decides (x%17 < 9 is the lower half)
+	uint8_t down = 0xff;
+	if(io_getQuantMode()==QUANT_MODE_NEAREST && io_getStepOffsetDown(note)<=quantValue)
 	{
-	  if( ((1<<  ((note+i)%12) ) & io_getActiveSteps()) != 0) break;
+	  down = io_getStepOffsetDown(note);
+	  if(down==offset && x-quantValue*17 >= 9) down = 0xff;
 	}
 	
-	note = note+i;
-	if(note>=12)
+	if(down<=offset)
 	{
-	  note -= 12;
-	  octave++;
+	  note = note<down ? note+12-down : note-down;
+	  quantValue -= down;
+	}
+	else
+	{
+	  note = note+offset;
+	  if(note>=12)
+	  {
+	    note -= 12;
+	  }
+	  
+	  quantValue += offset;
 	}
-	
-	quantValue = octave*12+note;
 	
 	//store to matrix
 	io_setCurrentQuantizedValue(note);
-	return quantValue*2;
+	lastQuantResult = quantValue*2;
+	return lastQuantResult;
+}
+//-----------------------------------------------------------
+static uint8_t continuous = 0;
+//control step ready: a control tick in continuous mode, always in triggered mode
+static uint8_t controlReady()
+{
+	if( !GATE_IN_CONNECTED )
+	{
+	  //no gate cable plugged in
+	  //continuous mode, quantize at CONTROL_RATE
+	  if(!continuous)
+	  {
+	    continuous = 1;
+	    timer_controlStart();
+	  }
+	  return timer_controlTick();
+	}
+	
+	if(continuous)
+	{
+	  continuous = 0;
+	  timer_controlStop();
+	}
+	return 1;
 }
 //-----------------------------------------------------------
+static void control()
+{
+	if(continuous)
+	{
+	  process();
+	}
+	else
+	{
+	  //triggered mode, prepare the next note
+	  preload();
+	}
+}
+//-----------------------------------------------------------
+static const char taskTriggers[] PROGMEM = "triggers";
+static const char taskControl[] PROGMEM = "control";
+static const char taskButtons[] PROGMEM = "buttons";
+static const char taskAutosave[] PROGMEM = "autosave";
+
+//in priority order, buttons and autosave use the time left by the control step
+//the LEDs are refreshed by the timer 1 compare B interrupt (IoMatrix.c)
+static const Task tasks[] = {
+	//run			ready		period		deadline	budget		name
+	{serviceTriggers,	event_getDepth,	0,		0,		TASK_US(100),	taskTriggers},
+	{control,		controlReady,	0,		0,		TASK_US(100),	taskControl},
+	{io_processButtonEvents, 0,		TASK_US(1000),	TASK_US(1000),	TASK_US(20),	taskButtons},
+	{checkAutosave,		0,		TASK_US(5000),	TASK_US(5000),	TASK_US(100),	taskAutosave},
+};
+#define TASK_COUNT (sizeof(tasks)/sizeof(Task))
+static TaskStats taskStats[TASK_COUNT];
+//-----------------------------------------------------------
 int main(void)
 {
     init();
     
     //read last button state from eeprom
     io_setActiveSteps( eeprom_ReadBuffer());
+    io_setQuantMode(eeprom_getState()->mode);
     
+    sched_init(tasks, taskStats, TASK_COUNT);
     while(1)
     {
-	//handle IOs (buttons + LED)		
-	io_processButtonsPipelined();
-	io_processLedPipelined();
-
-	checkAutosave();
-	if( !GATE_IN_CONNECTED )
-	{
-	  //no gate cable plugged in
-	  //continuous mode
-	  process();
-	}	
+	sched_run();
     }
 }
 //-----------------------------------------------------------
@@ -0,0 +1,116 @@
+/*
+ * scheduler.c
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include "scheduler.h"
+
+static const Task *sched_tasks;
+static TaskStats *sched_stats;
+static uint8_t sched_count = 0;
+//-----------------------------------------------------------
+void sched_init(const Task *tasks, TaskStats *stats, uint8_t count)
+{
+  sched_tasks = tasks;
+  sched_stats = stats;
+  sched_count = count;
+  
+  const uint16_t now = timer_now();
+  for(uint8_t i=0;i<count;i++)
+  {
+    stats[i] = (TaskStats){0};
+    stats[i].release = now;
+  }
+}
+//-----------------------------------------------------------
+static inline void saturatingInc(uint16_t *val)
+{
+  if(*val < 0xffff) (*val)++;
+}
+//-----------------------------------------------------------
+void sched_run()
+{
+  for(uint8_t i=0;i<sched_count;i++)
+  {
+    const Task *task = &sched_tasks[i];
+    TaskStats *stats = &sched_stats[i];
+    
+    if(task->ready)
+    {
+      if(!task->ready()) continue;
+    }
+    else if(task->period)
+    {
+      const uint16_t elapsed = timer_elapsed(stats->release);
+      if(elapsed < task->period) continue;
+      
+      const uint16_t delay = elapsed - task->period;
+      if(delay > stats->maxDelay) stats->maxDelay = delay;
+      if(task->deadline && delay > task->deadline) saturatingInc(&stats->misses);
+      
+      //next release one period later, start over if a whole period was lost
+      if(delay >= task->period)
+      {
+	stats->release = timer_now();
+      }
+      else
+      {
+	uint16_t release = stats->release + task->period;
+	if(release >= TIMER_TICKS_PER_PERIOD) release -= TIMER_TICKS_PER_PERIOD;
+	stats->release = release;
+      }
+    }
+    
+    const uint16_t start = timer_now();
+    task->run();
+    const uint16_t time = timer_elapsed(start);
+    
+    stats->runs++;
+    if(time > stats->maxTime) stats->maxTime = time;
+    if(time > task->budget) saturatingInc(&stats->overruns);
+    if(stats->count >= 0x8000)
+    {
+      stats->count >>= 1;
+      stats->sum >>= 1;
+    }
+    stats->count++;
+    stats->sum += time;
+  }
+}
+//-----------------------------------------------------------
+uint8_t sched_getTaskCount()
+{
+  return sched_count;
+}
+//-----------------------------------------------------------
+const Task* sched_getTask(uint8_t nr)
+{
+  return &sched_tasks[nr];
+}
+//-----------------------------------------------------------
+const TaskStats* sched_getStats(uint8_t nr)
+{
+  return &sched_stats[nr];
+}
+//-----------------------------------------------------------
+uint16_t sched_getAverage(uint8_t nr)
+{
+  const TaskStats *stats = &sched_stats[nr];
+  if(stats->count == 0) return 0;
+  return stats->sum / stats->count;
+}
+//-----------------------------------------------------------
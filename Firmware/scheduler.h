@@ -0,0 +1,70 @@
+/*
+ * scheduler.h
+ *
+ * cooperative task table for the main loop
+ *
+ *  This file is part of the Penrose Quantizer Firmware.
+ *
+ *  The Penrose Quantizer Firmware is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  The Penrose Quantizer Firmware is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Penrose Quantizer Firmware.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <avr/io.h>
+#include "timebase.h"
+
+//timer 1 ticks for a time in us (0.4us per tick = 8 cycles)
+#define TASK_US(us) ((uint16_t)((us)*(uint32_t)TIMER_TICKS_PER_MS/1000))
+#define TASK_TICK_CYCLES ((uint16_t)(F_CPU/1000/TIMER_TICKS_PER_MS))
+
+/* tasks are checked in table order on every pass, all ready tasks run.
+ * A task is either event driven (ready() returns 1 when there is work, it may take the event)
+ * or periodic (ready == 0). Periods, deadlines and budgets must be below TIMER_PERIOD_MS.
+ */
+typedef struct
+{
+  void (*run)(void);
+  uint8_t (*ready)(void);	//event driven task, 0 = periodic
+  uint16_t period;		//[ticks] periodic tasks, 0 = every pass
+  uint16_t deadline;		//[ticks] max start delay after the release, 0 = none
+  uint16_t budget;		//[ticks] max execution time
+  const char *name;		//PROGMEM
+} Task;
+
+typedef struct
+{
+  uint16_t release;		//time the task was last released
+  uint16_t runs;		//(wraps)
+  uint16_t overruns;		//execution time > budget (saturates)
+  uint16_t misses;		//start delay > deadline (saturates)
+  uint16_t maxTime;		//[ticks] longest execution time
+  uint16_t maxDelay;		//[ticks] longest start delay
+  uint16_t count;		//runs in sum, both are halved when count reaches 0x8000
+  uint32_t sum;			//[ticks] execution time of the last count runs
+} TaskStats;
+
+//-----------------------------------------------------------
+void sched_init(const Task *tasks, TaskStats *stats, uint8_t count);
+//one pass through the task table, called from the main loop
+void sched_run();
+
+uint8_t sched_getTaskCount();
+const Task* sched_getTask(uint8_t nr);
+const TaskStats* sched_getStats(uint8_t nr);
+//[ticks] average execution time
+uint16_t sched_getAverage(uint8_t nr);
+
+#endif /* SCHEDULER_H_ */
@@ -32,8 +32,8 @@ void spi_init(void)
 {
 	//init port
 	SPI_DDR  |= (1<<MOSI_PIN) | (1<<SCK_PIN) ;//MOSI+SCK as output
-	SPCR =  (1<<MSTR) | (1<<SPR1); //clock FCPU/64 = 20000000/64= 312.5kHz
-	SPSR = 0x00;
+	SPCR =  (1<<MSTR); //clock FCPU/2 = 20000000/2 = 10MHz, the MCP4802 takes up to 20MHz
+	SPSR = (1<<SPI2X);
 	/* SPI is not enabled here
 	 * it is just enabled before sending out data to the DAC
 	 * since the MISO and SS pins are also used for the button matrix
@@ -41,25 +41,13 @@ void spi_init(void)
 	 * */
 };
 //-----------------------------------------------------------
-unsigned char SPI_transmit(unsigned char data)
-{
-	// Start transmission
-	SPDR = data;
-
-	// Wait for transmission complete
-	while(!(SPSR & (1<<SPIF)));
-	data = SPDR;
-
-	return(data);
-};
-//-----------------------------------------------------------
 void spi_enable(uint8_t onOff)
 {
   if(onOff)
   {
-    SPCR |= (1<<SPE);
+    SPCR |= (1<<SPE) | (1<<SPIE);
   } else {
-    SPCR &= ~(1<<SPE);    
+    SPCR &= ~((1<<SPE) | (1<<SPIE));
   }
 }
 //-----------------------------------------------------------
@@ -27,7 +27,9 @@
 #include <avr/io.h>
 
 void spi_init(void);
-unsigned char SPI_transmit(unsigned char data);
+/* port on with the transfer complete interrupt, the SPI_STC_vect ISR of the
+ * driver using the port (MCP4802.c) feeds SPDR
+ */
 void spi_enable(uint8_t onOff);
 
 #endif /* SPI_H_ */
\ No newline at end of file
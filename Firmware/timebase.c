@@ -31,6 +31,9 @@
 
 static volatile uint8_t autosave_counter = 0;
 static volatile uint8_t autosave_flag = 1; //0 save needed, 1 no save needed
+static uint8_t timer_periods = 0; //time base periods in the current second
+static volatile uint8_t control_pending = 0; //control ticks not served yet
+static ControlStats control_stats = {0, 0, 0xff, 0};
 //-----------------------------------------------------------
 ISR (TIMER0_COMPA_vect)
 {
@@ -49,10 +52,10 @@ void timer_init()
   TIMSK0 |= (1<<OCIE0A);
   
   // Timer 1 (16-bit) configuration
-  TCCR1B |= (1<<CS12) | (1<<CS10); //prescaler 1024
-  // 20.000.000 / 1024 = 19531,25 = 1 sec
+  TCCR1B |= (1<<CS11); //prescaler 8
+  // 20.000.000 / 8 / 25000 = 100Hz = 10ms
   TCCR1B |= (1<<WGM12); // CTC Modus
-  OCR1A = 19531L; //timer => 999,9872 sec
+  OCR1A = TIMER_TICKS_PER_PERIOD-1;
   TIMSK1 |= (1<<OCIE1A);
 }
 //-----------------------------------------------------------
@@ -64,8 +67,85 @@ void timer0_start()
   TCCR0B |= (1<<CS02) | (1<<CS00); // Prescaler 1024
 }
 //-----------------------------------------------------------
+ISR (TIMER2_COMPA_vect)
+{
+  if(control_pending < 0xff) control_pending++;
+}
+//-----------------------------------------------------------
+void timer_controlStart()
+{
+  // Timer 2 CTC, prescaler 64
+  TCCR2A = (1<<WGM21);
+  OCR2A = CONTROL_TOP;
+  TCNT2 = 0;
+  control_pending = 0;
+  TIFR2 = (1<<OCF2A);
+  TIMSK2 |= (1<<OCIE2A);
+  TCCR2B = (1<<CS22);
+}
+//-----------------------------------------------------------
+void timer_controlStop()
+{
+  TCCR2B = 0;
+  TIMSK2 &= ~(1<<OCIE2A);
+}
+//-----------------------------------------------------------
+uint8_t timer_controlTick()
+{
+  if(control_pending == 0) return 0;
+  
+  const uint8_t sreg = SREG;
+  cli();
+  uint8_t late = TCNT2;
+  const uint8_t pending = control_pending;
+  control_pending = 0;
+  SREG = sreg;
+  //the compare match happens while TCNT2 is CONTROL_TOP, the next timer clock clears it
+  late = late==CONTROL_TOP ? 0 : late+1;
+  
+  if(pending > 1)
+  {
+    //overrun, the lateness includes whole periods and is not counted
+    const uint16_t missed = control_stats.missed + pending - 1;
+    control_stats.missed = missed < control_stats.missed ? 0xffff : missed;
+  }
+  else
+  {
+    if(late < control_stats.minLate) control_stats.minLate = late;
+    if(late > control_stats.maxLate) control_stats.maxLate = late;
+  }
+  control_stats.runs++;
+  return 1;
+}
+//-----------------------------------------------------------
+const ControlStats* timer_getControlStats()
+{
+  return &control_stats;
+}
+//-----------------------------------------------------------
+uint16_t timer_now()
+{
+  //16 bit read uses the TEMP register, an ISR reading TCNT1 must not interrupt it
+  const uint8_t sreg = SREG;
+  cli();
+  const uint16_t now = TCNT1;
+  SREG = sreg;
+  return now;
+}
+//-----------------------------------------------------------
+uint16_t timer_elapsed(uint16_t since)
+{
+  const uint16_t now = timer_now();
+  if(now >= since) return now - since;
+  return now + TIMER_TICKS_PER_PERIOD - since;
+}
+//-----------------------------------------------------------
 ISR (TIMER1_COMPA_vect)
 {
+  //count seconds
+  if(++timer_periods < 1000/TIMER_PERIOD_MS) return;
+  timer_periods = 0;
+  
   if(autosave_counter < AUTOSAVE_TIME)
   {
     autosave_counter++;
@@ -87,8 +167,14 @@ void checkAutosave()
   {
     if(autosave_counter >= AUTOSAVE_TIME)
     {
-      eeprom_WriteBuffer(io_getActiveSteps());    
-      autosave_flag = 1;
+      StateRecord newState = *eeprom_getState();
+      newState.steps = io_getActiveSteps();
+      newState.mode = io_getQuantMode();
+      //retried on the next call while the last record is still being written
+      if(eeprom_WriteState(&newState))
+      {
+	autosave_flag = 1;
+      }
     }
   }
 }
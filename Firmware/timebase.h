@@ -21,19 +21,61 @@
  */ 
 
 
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
 #define GATE_LENGTH 12 // [ms] maximum is 12 (=>240, more will not fit into OCR0A and a 16 bit timer must be used)
 #define AUTOSAVE_TIME 15 // [sec]
 
+/* Timer 1 is the time base: 20.000.000 / 8 = 2.5MHz, one tick = 0.4us
+ * it counts up to TIMER_TICKS_PER_PERIOD-1 (10ms) and starts again at 0
+ */
+#define TIMER_TICKS_PER_MS 2500
+#define TIMER_PERIOD_MS 10
+#define TIMER_TICKS_PER_PERIOD (TIMER_TICKS_PER_MS*TIMER_PERIOD_MS)
+
 void timer_init();
 
+/* Timer 2 is the control loop tick for continuous mode
+ * 20.000.000 / 64 = 312.5kHz, one tick = 3.2us
+ */
+#define CONTROL_RATE 4000 // [Hz] 2000..10000, quantizer runs per second
+#define CONTROL_PRESCALER 64
+#define CONTROL_TOP ((F_CPU/CONTROL_PRESCALER+CONTROL_RATE/2)/CONTROL_RATE - 1)
+#if CONTROL_TOP > 255 || CONTROL_RATE > 10000
+#error "CONTROL_RATE out of range"
+#endif
+
+typedef struct
+{
+  uint16_t runs;	//control ticks served (wraps)
+  uint16_t missed;	//ticks not served before the next one (saturates)
+  uint8_t minLate;	//earliest start after the tick [3.2us]
+  uint8_t maxLate;	//latest start after the tick, jitter = maxLate-minLate
+} ControlStats;
+
+/* current time base value [ticks], wraps every TIMER_PERIOD_MS */
+uint16_t timer_now();
+/* ticks from 'since' to now, valid for intervals < TIMER_PERIOD_MS */
+uint16_t timer_elapsed(uint16_t since);
+
 /* Gate Timer
  * This function will turn off the gate signal after GATE_LENGTH [ms]
  */
 void timer0_start();
 
+/* start/stop the control loop tick */
+void timer_controlStart();
+void timer_controlStop();
+/* returns 1 once per control tick, the caller runs the control step right away
+ * measures how late the step starts
+ */
+uint8_t timer_controlTick();
+const ControlStats* timer_getControlStats();
+
 /* called whenever a button is pressed.
  * autosave timer will be started and reset to zero.
  * this has 2 functions
@@ -45,9 +87,4 @@ void timer_touchAutosave();
 /* checks timer variables if an autosave is needed */
 void checkAutosave();
 
-
-
-
-
-
-
+#endif /* TIMEBASE_H_ */